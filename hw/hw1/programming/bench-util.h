@@ -0,0 +1,55 @@
+// Small helpers shared by the CPU benchmarks (pagerank_bench,
+// cipher_bench): comma separated argument lists and median/best timing.
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+
+// Comma separated list of integers.
+inline std::vector<long long> parse_list(const char *arg)
+{
+  std::vector<long long> values;
+  const char *p = arg;
+  while(*p)
+  {
+    char *end;
+    values.push_back(strtoll(p, &end, 10));
+    if(end == p) break;
+    p = *end == ',' ? end + 1 : end;
+  }
+  return values;
+}
+
+// Comma separated list of names.
+inline std::vector<std::string> parse_names(const char *arg)
+{
+  std::vector<std::string> names;
+  std::string list(arg);
+  size_t start = 0, comma;
+  while((comma = list.find(',', start)) != std::string::npos)
+  {
+    names.push_back(list.substr(start, comma - start));
+    start = comma + 1;
+  }
+  names.push_back(list.substr(start));
+  return names;
+}
+
+struct sweep_times
+{
+  std::vector<double> seconds;
+
+  double median()
+  {
+    std::vector<double> s(seconds);
+    std::sort(s.begin(), s.end());
+    return s[s.size() / 2];
+  }
+  double best() { return *std::min_element(seconds.begin(), seconds.end()); }
+};
+
+#endif
@@ -0,0 +1,256 @@
+// Multithreaded CPU versions of the shift cipher.
+//
+// Same result as host_shift_cypher in cipher.cu (every byte plus the shift,
+// mod 256), but the bytes are added 16, 32 or 64 at a time with SSE2, AVX2
+// or AVX-512BW, picked at run time from what the CPU supports, and the
+// buffer is split over OpenMP threads. Only needs a C++ compiler with
+// OpenMP, so it can be built without nvcc.
+//
+// A packed add of a replicated shift (what shift_cypher_int does) lets the
+// carry out of one byte spill into the next; the portable fallback uses
+// carry-free SWAR instead, see host_swar_add_bytes.
+
+#ifndef CIPHER_CPU_H
+#define CIPHER_CPU_H
+
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include "omp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CIPHER_CPU_X86 1
+#include <immintrin.h>
+#endif
+
+enum host_simd_level
+{
+  HOST_SIMD_SWAR = 0,  // 8 bytes per step in a 64-bit register
+  HOST_SIMD_SSE2,
+  HOST_SIMD_AVX2,
+  HOST_SIMD_AVX512,
+  HOST_SIMD_LEVELS
+};
+
+inline const char *host_simd_name(int level)
+{
+  static const char *names[HOST_SIMD_LEVELS] = { "swar", "sse2", "avx2", "avx512" };
+  return level >= 0 && level < HOST_SIMD_LEVELS ? names[level] : "unknown";
+}
+
+// Ask the CPU for the widest instruction set it runs.
+inline int host_simd_probe()
+{
+  int detected = HOST_SIMD_SWAR;
+#ifdef CIPHER_CPU_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512bw"))  detected = HOST_SIMD_AVX512;
+  else if(__builtin_cpu_supports("avx2")) detected = HOST_SIMD_AVX2;
+  else if(__builtin_cpu_supports("sse2")) detected = HOST_SIMD_SSE2;
+#endif
+  return detected;
+}
+
+// Widest instruction set this CPU runs. Safe to call from several threads
+// at once.
+inline int host_simd_detect()
+{
+  // initialized once, by whichever thread gets here first
+  static const int level = host_simd_probe();
+  return level;
+}
+
+// Size of the last level cache in bytes, or a conservative guess if the
+// system doesn't tell us.
+inline size_t host_llc_bytes()
+{
+  long llc = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  if(llc <= 0) llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  if(llc <= 0) llc = 8 << 20;
+  return (size_t)llc;
+}
+
+// Eight independent byte adds in one 64-bit add. The low seven bits of
+// every lane are added with the top bit cleared, so no carry can leave a
+// lane; the top bit of the sum is then the xor of the two top bits and the
+// carry that came in from bit 6.
+inline unsigned long long host_swar_add_bytes(unsigned long long x, unsigned long long s)
+{
+  const unsigned long long high = 0x8080808080808080ULL;
+  return ((x & ~high) + (s & ~high)) ^ ((x ^ s) & high);
+}
+
+inline void host_shift_cypher_swar(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  const unsigned long long s = 0x0101010101010101ULL * shift;
+  size_t i = 0;
+  for(; i + 8 <= length; i += 8)
+  {
+    unsigned long long x;
+    memcpy(&x, input + i, 8);   // unaligned load, a single mov
+    x = host_swar_add_bytes(x, s);
+    memcpy(output + i, &x, 8);
+  }
+  for(; i < length; i++) output[i] = (unsigned char)(input[i] + shift);
+}
+
+#ifdef CIPHER_CPU_X86
+// The vector versions do the unaligned head with SWAR so that every vector
+// store is aligned, which non-temporal stores require. Loads stay
+// unaligned; input and output needn't have the same alignment.
+
+__attribute__((target("sse2")))
+inline void host_shift_cypher_sse2(const unsigned char *input, unsigned char *output, unsigned char shift,
+                                   size_t length, bool streaming)
+{
+  size_t head = (16 - ((size_t)output & 15)) & 15;
+  if(head > length) head = length;
+  host_shift_cypher_swar(input, output, shift, head);
+  const __m128i s = _mm_set1_epi8((char)shift);
+  size_t i = head;
+  if(streaming)
+  {
+    for(; i + 64 <= length; i += 64)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i *)(input + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(input + i + 16));
+      __m128i c = _mm_loadu_si128((const __m128i *)(input + i + 32));
+      __m128i d = _mm_loadu_si128((const __m128i *)(input + i + 48));
+      _mm_stream_si128((__m128i *)(output + i),      _mm_add_epi8(a, s));
+      _mm_stream_si128((__m128i *)(output + i + 16), _mm_add_epi8(b, s));
+      _mm_stream_si128((__m128i *)(output + i + 32), _mm_add_epi8(c, s));
+      _mm_stream_si128((__m128i *)(output + i + 48), _mm_add_epi8(d, s));
+    }
+    _mm_sfence();
+  }
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)(input + i));
+    _mm_store_si128((__m128i *)(output + i), _mm_add_epi8(a, s));
+  }
+  host_shift_cypher_swar(input + i, output + i, shift, length - i);
+}
+
+__attribute__((target("avx2")))
+inline void host_shift_cypher_avx2(const unsigned char *input, unsigned char *output, unsigned char shift,
+                                   size_t length, bool streaming)
+{
+  size_t head = (32 - ((size_t)output & 31)) & 31;
+  if(head > length) head = length;
+  host_shift_cypher_swar(input, output, shift, head);
+  const __m256i s = _mm256_set1_epi8((char)shift);
+  size_t i = head;
+  if(streaming)
+  {
+    for(; i + 128 <= length; i += 128)
+    {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(input + i));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(input + i + 32));
+      __m256i c = _mm256_loadu_si256((const __m256i *)(input + i + 64));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(input + i + 96));
+      _mm256_stream_si256((__m256i *)(output + i),      _mm256_add_epi8(a, s));
+      _mm256_stream_si256((__m256i *)(output + i + 32), _mm256_add_epi8(b, s));
+      _mm256_stream_si256((__m256i *)(output + i + 64), _mm256_add_epi8(c, s));
+      _mm256_stream_si256((__m256i *)(output + i + 96), _mm256_add_epi8(d, s));
+    }
+    _mm_sfence();
+  }
+  for(; i + 32 <= length; i += 32)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(input + i));
+    _mm256_store_si256((__m256i *)(output + i), _mm256_add_epi8(a, s));
+  }
+  host_shift_cypher_swar(input + i, output + i, shift, length - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void host_shift_cypher_avx512(const unsigned char *input, unsigned char *output, unsigned char shift,
+                                     size_t length, bool streaming)
+{
+  size_t head = (64 - ((size_t)output & 63)) & 63;
+  if(head > length) head = length;
+  host_shift_cypher_swar(input, output, shift, head);
+  const __m512i s = _mm512_set1_epi8((char)shift);
+  size_t i = head;
+  if(streaming)
+  {
+    for(; i + 256 <= length; i += 256)
+    {
+      __m512i a = _mm512_loadu_si512((const void *)(input + i));
+      __m512i b = _mm512_loadu_si512((const void *)(input + i + 64));
+      __m512i c = _mm512_loadu_si512((const void *)(input + i + 128));
+      __m512i d = _mm512_loadu_si512((const void *)(input + i + 192));
+      _mm512_stream_si512((__m512i *)(output + i),       _mm512_add_epi8(a, s));
+      _mm512_stream_si512((__m512i *)(output + i + 64),  _mm512_add_epi8(b, s));
+      _mm512_stream_si512((__m512i *)(output + i + 128), _mm512_add_epi8(c, s));
+      _mm512_stream_si512((__m512i *)(output + i + 192), _mm512_add_epi8(d, s));
+    }
+    _mm_sfence();
+  }
+  for(; i + 64 <= length; i += 64)
+  {
+    __m512i a = _mm512_loadu_si512((const void *)(input + i));
+    _mm512_store_si512((void *)(output + i), _mm512_add_epi8(a, s));
+  }
+  // the last partial vector with a masked load and store
+  if(i < length)
+  {
+    __mmask64 mask = (__mmask64)(~0ULL >> (64 - (length - i)));
+    __m512i a = _mm512_maskz_loadu_epi8(mask, input + i);
+    _mm512_mask_storeu_epi8(output + i, mask, _mm512_add_epi8(a, s));
+  }
+}
+#endif
+
+// Single threaded shift with the given instruction set; levels this build
+// or CPU can't run fall back to the next narrower one. streaming uses
+// non-temporal stores for the output.
+inline void host_shift_cypher_simd(const unsigned char *input, unsigned char *output, unsigned char shift,
+                                   size_t length, int level, bool streaming)
+{
+#ifdef CIPHER_CPU_X86
+  if(level > host_simd_detect()) level = host_simd_detect();
+  switch(level)
+  {
+    case HOST_SIMD_AVX512: host_shift_cypher_avx512(input, output, shift, length, streaming); return;
+    case HOST_SIMD_AVX2:   host_shift_cypher_avx2(input, output, shift, length, streaming);   return;
+    case HOST_SIMD_SSE2:   host_shift_cypher_sse2(input, output, shift, length, streaming);   return;
+  }
+#endif
+  host_shift_cypher_swar(input, output, shift, length);
+}
+
+// Multithreaded shift. Every thread takes one contiguous chunk, cut where
+// the output is 64-byte aligned so no two threads write the same cache
+// line. If input and output together don't fit in the last level cache the
+// output would only evict the input on its way to memory, so it is written
+// with non-temporal stores instead.
+inline void host_shift_cypher_omp(const unsigned char *input, unsigned char *output, unsigned char shift,
+                                  size_t length, int level)
+{
+  const bool streaming = 2 * length > host_llc_bytes();
+  const int nr_threads = omp_get_max_threads();
+  const size_t misalign = (size_t)output & 63;
+  const size_t chunk = (length + nr_threads - 1) / nr_threads;
+  #pragma omp parallel for num_threads(nr_threads) schedule(static, 1)
+  for(int t = 0; t < nr_threads; t++)
+  {
+    size_t begin = t == 0 ? 0 : (((size_t)t * chunk + misalign + 63) & ~(size_t)63) - misalign;
+    size_t end = t == nr_threads - 1 ? length : ((((size_t)t + 1) * chunk + misalign + 63) & ~(size_t)63) - misalign;
+    if(end > length) end = length;
+    if(begin >= end) continue;
+    host_shift_cypher_simd(input + begin, output + begin, shift, end - begin, level, streaming);
+  }
+}
+
+inline void host_shift_cypher_omp(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  host_shift_cypher_omp(input, output, shift, length, host_simd_detect());
+}
+
+#endif
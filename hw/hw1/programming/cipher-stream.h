@@ -0,0 +1,208 @@
+// Streaming shift cipher for inputs of any size.
+//
+// The input is read in large chunks into a small ring of buffers and goes
+// through a three stage pipeline:
+//
+//   reader thread  - read()s the next chunk into a free buffer, ahead of
+//                    the others, with the kernel's sequential read-ahead on
+//   calling thread - shifts a full buffer in place (host_shift_cypher_omp,
+//                    so with all OpenMP threads)
+//   writer thread  - write()s shifted buffers out in order
+//
+// While one buffer is being shifted the next is already being read and the
+// previous one written, so with at least three buffers the run goes at the
+// speed of the slowest stage, normally the disk. Peak memory is
+// nr_buffers * chunk_bytes whatever the input size, and pipes work as well
+// as files, so "-" can be used for stdin/stdout.
+
+#ifndef CIPHER_STREAM_H
+#define CIPHER_STREAM_H
+
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cipher-cpu.h"
+
+enum cipher_slot_state { CIPHER_SLOT_EMPTY, CIPHER_SLOT_READ, CIPHER_SLOT_SHIFTED };
+
+struct cipher_slot
+{
+  unsigned char *data;
+  size_t size;        // 0 in a READ/SHIFTED slot marks the end of the input
+  int state;
+};
+
+struct cipher_stream
+{
+  int in_fd, out_fd;
+  size_t chunk_bytes;
+  std::vector<cipher_slot> slots;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  int error;                 // first errno seen by any stage, 0 if none
+  unsigned long long bytes;  // bytes written so far
+};
+
+// Block until slot k is in the given state or some stage failed. Returns
+// false on failure.
+inline bool host_stream_wait(cipher_stream &s, size_t k, int state)
+{
+  pthread_mutex_lock(&s.lock);
+  while(s.slots[k].state != state && !s.error) pthread_cond_wait(&s.changed, &s.lock);
+  bool ok = !s.error;
+  pthread_mutex_unlock(&s.lock);
+  return ok;
+}
+
+inline void host_stream_set(cipher_stream &s, size_t k, int state)
+{
+  pthread_mutex_lock(&s.lock);
+  s.slots[k].state = state;
+  pthread_cond_broadcast(&s.changed);
+  pthread_mutex_unlock(&s.lock);
+}
+
+inline void host_stream_fail(cipher_stream &s, int error)
+{
+  pthread_mutex_lock(&s.lock);
+  if(!s.error) s.error = error ? error : EIO;
+  pthread_cond_broadcast(&s.changed);
+  pthread_mutex_unlock(&s.lock);
+}
+
+inline void *host_stream_reader(void *arg)
+{
+  cipher_stream &s = *(cipher_stream *)arg;
+  off_t offset = 0;
+  for(size_t k = 0; ; k = (k + 1) % s.slots.size())
+  {
+    if(!host_stream_wait(s, k, CIPHER_SLOT_EMPTY)) return 0;
+    // fill the whole chunk; pipes hand out much less per read()
+    cipher_slot &slot = s.slots[k];
+    slot.size = 0;
+    while(slot.size < s.chunk_bytes)
+    {
+      ssize_t got = read(s.in_fd, slot.data + slot.size, s.chunk_bytes - slot.size);
+      if(got < 0 && errno == EINTR) continue;
+      if(got < 0) { host_stream_fail(s, errno); return 0; }
+      if(got == 0) break;
+      slot.size += got;
+    }
+    // the chunk is in our buffer now, no need to keep it in the page cache
+    posix_fadvise(s.in_fd, offset, slot.size, POSIX_FADV_DONTNEED);
+    offset += slot.size;
+    size_t size = slot.size;
+    host_stream_set(s, k, CIPHER_SLOT_READ);
+    if(size == 0) return 0;
+  }
+}
+
+inline void *host_stream_writer(void *arg)
+{
+  cipher_stream &s = *(cipher_stream *)arg;
+  for(size_t k = 0; ; k = (k + 1) % s.slots.size())
+  {
+    if(!host_stream_wait(s, k, CIPHER_SLOT_SHIFTED)) return 0;
+    cipher_slot &slot = s.slots[k];
+    if(slot.size == 0) return 0;
+    size_t done = 0;
+    while(done < slot.size)
+    {
+      ssize_t put = write(s.out_fd, slot.data + done, slot.size - done);
+      if(put < 0 && errno == EINTR) continue;
+      if(put < 0) { host_stream_fail(s, errno); return 0; }
+      done += put;
+    }
+    pthread_mutex_lock(&s.lock);
+    s.bytes += slot.size;
+    pthread_mutex_unlock(&s.lock);
+    host_stream_set(s, k, CIPHER_SLOT_EMPTY);
+  }
+}
+
+// Shift everything from in_fd to out_fd. Returns false with errno set if a
+// read, write or allocation failed; *bytes (if given) is the number of
+// bytes written either way.
+inline bool host_shift_cypher_stream(int in_fd, int out_fd, unsigned char shift, size_t chunk_bytes, int nr_buffers,
+                                     unsigned long long *bytes)
+{
+  cipher_stream s;
+  s.in_fd = in_fd;
+  s.out_fd = out_fd;
+  s.chunk_bytes = chunk_bytes;
+  s.error = 0;
+  s.bytes = 0;
+  s.slots.resize(nr_buffers < 2 ? 2 : nr_buffers);
+  bool allocated = true;
+  for(size_t k = 0; k < s.slots.size(); k++)
+  {
+    void *p = 0;
+    if(posix_memalign(&p, 4096, chunk_bytes) != 0) p = 0;
+    s.slots[k].data = (unsigned char *)p;
+    s.slots[k].size = 0;
+    s.slots[k].state = CIPHER_SLOT_EMPTY;
+    if(!p) allocated = false;
+  }
+  if(!allocated)
+  {
+    for(size_t k = 0; k < s.slots.size(); k++) free(s.slots[k].data);
+    if(bytes) *bytes = 0;
+    errno = ENOMEM;
+    return false;
+  }
+  posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  pthread_mutex_init(&s.lock, 0);
+  pthread_cond_init(&s.changed, 0);
+
+  pthread_t reader, writer;
+  pthread_create(&reader, 0, host_stream_reader, &s);
+  pthread_create(&writer, 0, host_stream_writer, &s);
+  int level = host_simd_detect();
+  for(size_t k = 0; ; k = (k + 1) % s.slots.size())
+  {
+    if(!host_stream_wait(s, k, CIPHER_SLOT_READ)) break;
+    cipher_slot &slot = s.slots[k];
+    size_t size = slot.size;
+    host_shift_cypher_omp(slot.data, slot.data, shift, size, level);
+    host_stream_set(s, k, CIPHER_SLOT_SHIFTED);
+    if(size == 0) break;
+  }
+  pthread_join(reader, 0);
+  pthread_join(writer, 0);
+
+  pthread_cond_destroy(&s.changed);
+  pthread_mutex_destroy(&s.lock);
+  for(size_t k = 0; k < s.slots.size(); k++) free(s.slots[k].data);
+  if(bytes) *bytes = s.bytes;
+  if(s.error) errno = s.error;
+  return s.error == 0;
+}
+
+// Same with file names; "-" is stdin or stdout.
+inline bool host_shift_cypher_stream(const char *in_name, const char *out_name, unsigned char shift,
+                                     size_t chunk_bytes, int nr_buffers, unsigned long long *bytes)
+{
+  if(bytes) *bytes = 0;
+  int in_fd = strcmp(in_name, "-") == 0 ? 0 : open(in_name, O_RDONLY);
+  if(in_fd < 0) return false;
+  int out_fd = strcmp(out_name, "-") == 0 ? 1 : open(out_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(out_fd < 0)
+  {
+    int error = errno;
+    if(in_fd != 0) close(in_fd);
+    errno = error;
+    return false;
+  }
+  bool ok = host_shift_cypher_stream(in_fd, out_fd, shift, chunk_bytes, nr_buffers, bytes);
+  int error = errno;
+  if(in_fd != 0) close(in_fd);
+  if(out_fd != 1 && close(out_fd) != 0 && ok) { ok = false; error = errno; }
+  errno = error;
+  return ok;
+}
+
+#endif
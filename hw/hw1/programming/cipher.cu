@@ -31,6 +31,10 @@
  * What is the bandwidth the is achieved on the copies from
  * the host to the device and back the other way?  How does
  * this compare to the bandwidth achieved on the device?
+ *
+ * Run as ./cipher <input> <output> [shift] to encipher a file of any size
+ * on the host instead, streamed through a few chunk buffers (see
+ * cipher-stream.h); "-" is stdin or stdout.
  */
 
 #include <stdlib.h>
@@ -41,6 +45,8 @@
 #include <thrust/device_vector.h>
 
 #include "mp1-util.h"
+#include "cipher-cpu.h"
+#include "cipher-stream.h"
 
 
 // Repeating from the tutorial, just in case you haven't looked at it.
@@ -69,6 +75,14 @@ __global__ void shift_cypher(unsigned char *input_array, unsigned char *output_a
   }
 }
 
+// Four independent byte adds in one 32-bit add: a plain add of the
+// replicated shift would carry out of a byte that wraps past 255 into its
+// neighbour. Same trick as host_swar_add_bytes in cipher-cpu.h.
+__device__ __forceinline__ unsigned int add_bytes(unsigned int x, unsigned int shift)
+{
+  return ((x & 0x7f7f7f7f) + (shift & 0x7f7f7f7f)) ^ ((x ^ shift) & 0x80808080);
+}
+
 //Here we load 4 bytes at a time instead of just 1
 //to improve the bandwidth due to a better memory
 //access pattern
@@ -76,7 +90,7 @@ __global__ void shift_cypher_int(unsigned int *input_array, unsigned int *output
 {
   unsigned int i = threadIdx.x + (blockIdx.y * gridDim.x + blockIdx.x) * blockDim.x;
   if(i<array_length){
-    output_array[i] = input_array[i] + shift_amount;
+    output_array[i] = add_bytes(input_array[i], shift_amount);
   }
 }
 
@@ -86,8 +100,8 @@ __global__ void shift_cypher_int2(uint2 *input_array, uint2 *output_array, unsig
 {
   unsigned int i = threadIdx.x + (blockIdx.y * gridDim.x + blockIdx.x) * blockDim.x;
   if(i<array_length){
-    output_array[i].x = input_array[i].x + shift_amount;
-    output_array[i].y = input_array[i].y + shift_amount;
+    output_array[i].x = add_bytes(input_array[i].x, shift_amount);
+    output_array[i].y = add_bytes(input_array[i].y, shift_amount);
   }
 }
 
@@ -124,8 +138,26 @@ bool checkResults(std::vector<unsigned char> &cipher_text_host, unsigned char *d
     return true;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
+  // streaming mode, host only
+  if (argc >= 3) {
+      unsigned char shift_amount = argc > 3 ? (unsigned char)atoi(argv[3]) : (rand() % 25) + 1;
+      const size_t chunk_bytes = 16 << 20;
+      const int nr_buffers = 4;
+      unsigned long long bytes = 0;
+      double start = omp_get_wtime();
+      if (!host_shift_cypher_stream(argv[1], argv[2], shift_amount, chunk_bytes, nr_buffers, &bytes)) {
+          fprintf(stderr, "couldn't encipher %s into %s: %s\n", argv[1], argv[2], strerror(errno));
+          return 1;
+      }
+      double seconds = omp_get_wtime() - start;
+      // report on stderr, the output may be stdout
+      fprintf(stderr, "enciphered %llu bytes with shift %d in %.2f ms, %.2f MB/s\n",
+              bytes, (int)shift_amount, seconds * 1000.0, bytes / seconds / 1e6);
+      return 0;
+  }
+
 
   //First load the text 
   std::ifstream ifs("mobydick.txt", std::ios::binary);
@@ -192,6 +224,8 @@ int main(void)
   check_launch("copy to gpu");
   stop_timer(&timer,"copy to gpu");
   
+  bool noErrors = true;
+
   // generate reference output
   {
       start_timer(&timer);
@@ -199,11 +233,29 @@ int main(void)
       stop_timer(&timer,"host shift cypher");
   }
 
+  // multithreaded SIMD versions on the host, every instruction set this
+  // CPU supports; bandwidth counts the bytes read plus the bytes written
+  {
+      std::vector<unsigned char> cipher_text_omp(text.size());
+      for (int level = HOST_SIMD_SWAR; level <= host_simd_detect(); ++level) {
+          // once untimed to fault in the output pages
+          host_shift_cypher_omp(&text[0], &cipher_text_omp[0], shift_amount, text.size(), level);
+          double start = omp_get_wtime();
+          host_shift_cypher_omp(&text[0], &cipher_text_omp[0], shift_amount, text.size(), level);
+          double seconds = omp_get_wtime() - start;
+          printf("host omp %s shift cypher took %.2f ms, %.2f GB/s\n", host_simd_name(level),
+                 seconds * 1000.0, 2.0 * text.size() / seconds / 1e9);
+          if (cipher_text_omp != cipher_text_host) {
+              printf("Output of host omp %s version and host version didn't match! \n", host_simd_name(level));
+              noErrors = false;
+          }
+      }
+  }
+
   // choose a number of threads per block
   // we use 512 threads here
   const int block_size = 512;
 
-  bool noErrors = true;
   // generate GPU char output
   {
       //TODO assign correct value
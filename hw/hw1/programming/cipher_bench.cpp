@@ -0,0 +1,228 @@
+/* Shift cipher CPU bandwidth benchmark
+ *
+ * Times the shift cipher transform (read a buffer, add the shift to every
+ * byte, write a second buffer) on the host over every combination of
+ * buffer size, element width, thread count and chunk size, to find where
+ * the bandwidth roofline of a machine sits from L1 out to DRAM. The
+ * element width picks the kernel:
+ *
+ *    1  one byte at a time
+ *    4  32-bit SWAR
+ *    8  64-bit SWAR
+ *   16  SSE2
+ *   32  AVX2
+ *   64  AVX-512BW
+ *
+ * The scalar and SWAR kernels are compiled without auto-vectorization so
+ * they really move 1, 4 or 8 bytes per step; widths the CPU can't run are
+ * skipped. A chunk size of 0 gives every thread one equal, contiguous
+ * share, as host_shift_cypher_omp does; other chunk sizes hand chunks out
+ * dynamically. Small buffers are transformed many times per sample (each
+ * thread repeats its own share, so it stays in that core's cache) so that
+ * every sample moves at least 64 MB.
+ *
+ * Output is one CSV row per combination, with the median and minimum time
+ * of one pass over the buffer; GB/s counts the bytes read plus the bytes
+ * written:
+ *
+ *   buffer_bytes,width,kernel,threads,chunk_bytes,passes,samples,
+ *   median_ms,min_ms,median_gb_s,best_gb_s
+ *
+ * usage: ./cipher_bench [-b bytes,...] [-w widths,...] [-t threads,...]
+ *                       [-c chunk_bytes,...] [-r samples]
+ *   defaults: -b 4K,16K,...,256M -w 1,4,8,16,32,64 -t <all cores> -c 0 -r 11
+ */
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "omp.h"
+#include "bench-util.h"
+#include "cipher-cpu.h"
+
+typedef void (*shift_kernel)(const unsigned char *, unsigned char *, unsigned char, size_t);
+
+// host_swar_add_bytes for any word size; for a single byte it is a plain
+// add.
+template <typename Word>
+__attribute__((optimize("no-tree-vectorize")))
+void shift_words(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  const Word high = (Word)0x8080808080808080ULL;
+  const Word s = (Word)(0x0101010101010101ULL * shift);
+  size_t i = 0;
+  for(; i + sizeof(Word) <= length; i += sizeof(Word))
+  {
+    Word x;
+    memcpy(&x, input + i, sizeof(Word));
+    x = ((x & ~high) + (s & ~high)) ^ ((x ^ s) & high);
+    memcpy(output + i, &x, sizeof(Word));
+  }
+  for(; i < length; i++) output[i] = (unsigned char)(input[i] + shift);
+}
+
+#ifdef CIPHER_CPU_X86
+void shift_sse2(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  host_shift_cypher_sse2(input, output, shift, length, false);
+}
+void shift_avx2(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  host_shift_cypher_avx2(input, output, shift, length, false);
+}
+void shift_avx512(const unsigned char *input, unsigned char *output, unsigned char shift, size_t length)
+{
+  host_shift_cypher_avx512(input, output, shift, length, false);
+}
+#endif
+
+// Kernel for an element width, 0 if there is none or the CPU can't run it.
+shift_kernel kernel_for_width(int width, const char **name)
+{
+  int level = host_simd_detect();
+  switch(width)
+  {
+    case 1: *name = "byte";   return shift_words<unsigned char>;
+    case 4: *name = "swar32"; return shift_words<unsigned int>;
+    case 8: *name = "swar64"; return shift_words<unsigned long long>;
+#ifdef CIPHER_CPU_X86
+    case 16: *name = "sse2";   return level >= HOST_SIMD_SSE2   ? shift_sse2   : 0;
+    case 32: *name = "avx2";   return level >= HOST_SIMD_AVX2   ? shift_avx2   : 0;
+    case 64: *name = "avx512"; return level >= HOST_SIMD_AVX512 ? shift_avx512 : 0;
+#endif
+  }
+  *name = "none";
+  return 0;
+}
+
+// Transform length bytes passes times with nr_threads threads. Chunk
+// boundaries are multiples of 64 so no two threads share a cache line.
+void run_passes(shift_kernel kernel, const unsigned char *input, unsigned char *output, size_t length,
+                int nr_threads, size_t chunk_bytes, int passes)
+{
+  bool dynamic = chunk_bytes != 0;
+  if(!dynamic) chunk_bytes = (length + nr_threads - 1) / nr_threads;
+  chunk_bytes = (chunk_bytes + 63) & ~(size_t)63;
+  long long nr_chunks = (long long)((length + chunk_bytes - 1) / chunk_bytes);
+  omp_set_schedule(dynamic ? omp_sched_dynamic : omp_sched_static, 1);
+  // no barrier between passes: a pass only reads input, and with a static
+  // schedule every thread keeps transforming the same share
+  #pragma omp parallel num_threads(nr_threads)
+  for(int p = 0; p < passes; p++)
+  {
+    #pragma omp for schedule(runtime) nowait
+    for(long long c = 0; c < nr_chunks; c++)
+    {
+      size_t begin = (size_t)c * chunk_bytes;
+      size_t end = std::min(begin + chunk_bytes, length);
+      kernel(input + begin, output + begin, 7, end - begin);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<long long> sizes;
+  for(long long b = 4 << 10; b <= (256LL << 20); b *= 4) sizes.push_back(b);
+  std::vector<long long> widths;
+  widths.push_back(1); widths.push_back(4); widths.push_back(8);
+  widths.push_back(16); widths.push_back(32); widths.push_back(64);
+  std::vector<long long> thread_counts(1, omp_get_max_threads());
+  std::vector<long long> chunk_sizes(1, 0);
+  int samples = 11;
+  const long long min_sample_bytes = 64LL << 20;
+
+  int opt;
+  while((opt = getopt(argc, argv, "b:w:t:c:r:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'b': sizes         = parse_list(optarg); break;
+      case 'w': widths        = parse_list(optarg); break;
+      case 't': thread_counts = parse_list(optarg); break;
+      case 'c': chunk_sizes   = parse_list(optarg); break;
+      case 'r': samples = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-b bytes,...] [-w widths,...] [-t threads,...] [-c chunk_bytes,...] [-r samples]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(samples < 1 || sizes.empty() || widths.empty() || thread_counts.empty() || chunk_sizes.empty())
+  {
+    fprintf(stderr, "nothing to run\n");
+    return 1;
+  }
+
+  long long max_size = *std::max_element(sizes.begin(), sizes.end());
+  void *in_p = 0, *out_p = 0;
+  if(max_size <= 0 || posix_memalign(&in_p, 64, max_size) != 0 || posix_memalign(&out_p, 64, max_size) != 0)
+  {
+    fprintf(stderr, "couldn't allocate memory\n");
+    return 1;
+  }
+  unsigned char *input = (unsigned char *)in_p, *output = (unsigned char *)out_p;
+  // first touch with every thread, so the pages are spread like the work
+  #pragma omp parallel for schedule(static)
+  for(long long i = 0; i < max_size; i++)
+  {
+    input[i] = (unsigned char)(i * 131);
+    output[i] = 0;
+  }
+  fprintf(stderr, "widest instruction set %s, last level cache %zu bytes\n", host_simd_name(host_simd_detect()), host_llc_bytes());
+
+  printf("buffer_bytes,width,kernel,threads,chunk_bytes,passes,samples,median_ms,min_ms,median_gb_s,best_gb_s\n");
+  for(size_t w = 0; w < widths.size(); w++)
+  {
+    const char *name;
+    shift_kernel kernel = kernel_for_width((int)widths[w], &name);
+    if(!kernel)
+    {
+      fprintf(stderr, "skipping width %lld, not supported here\n", widths[w]);
+      continue;
+    }
+    for(size_t b = 0; b < sizes.size(); b++)
+    {
+      size_t length = (size_t)sizes[b];
+      int passes = (int)std::max(1LL, min_sample_bytes / (long long)length);
+      for(size_t t = 0; t < thread_counts.size(); t++)
+      {
+        for(size_t c = 0; c < chunk_sizes.size(); c++)
+        {
+          int threads = (int)thread_counts[t];
+          size_t chunk = (size_t)chunk_sizes[c];
+          sweep_times times;
+          // one untimed pass to warm the caches, into a cleared output so
+          // the check below sees this kernel's result
+          memset(output, 0, length);
+          run_passes(kernel, input, output, length, threads, chunk, 1);
+          for(int s = 0; s < samples; s++)
+          {
+            double start = omp_get_wtime();
+            run_passes(kernel, input, output, length, threads, chunk, passes);
+            times.seconds.push_back((omp_get_wtime() - start) / passes);
+          }
+          for(size_t i = 0; i < length; i++)
+          {
+            if(output[i] != (unsigned char)(input[i] + 7))
+            {
+              fprintf(stderr, "%s kernel wrong at byte %zu\n", name, i);
+              return 1;
+            }
+          }
+          double median = times.median(), best = times.best();
+          printf("%zu,%d,%s,%d,%zu,%d,%d,%.6f,%.6f,%.2f,%.2f\n", length, (int)widths[w], name, threads, chunk,
+                 passes, samples, median * 1000.0, best * 1000.0, 2.0 * length / median / 1e9, 2.0 * length / best / 1e9);
+          fflush(stdout);
+        }
+      }
+    }
+  }
+  free(in_p);
+  free(out_p);
+  return 0;
+}
@@ -0,0 +1,269 @@
+// Gather-apply engine over the PageRank CSR.
+//
+// A vertex program is a small struct with inline members; the engine is a
+// template on it, so gather/combine/apply are inlined into the same
+// edge-balanced OpenMP traversal as host_graph_propagate_omp:
+//
+//   typedef ... value_type;
+//   value_type identity() const;                         // empty gather
+//   value_type gather(const value_type *in, graph_node_t src, graph_offset_t j) const;
+//   value_type combine(value_type a, value_type b) const; // associative
+//   value_type apply(unsigned int i, value_type gathered, const value_type *in) const;
+//   double delta(value_type before, value_type after) const;
+//
+// Row i gathers over its incoming links (src = graph_edges[j]). Because
+// combine is associative, rows that straddle a partition boundary are
+// gathered piecewise and merged afterwards, exactly like the partial sums
+// in host_graph_propagate_omp. The engine runs on any CSR, so a graph
+// reordered with host_graph_permute gets the same locality benefit here.
+
+#ifndef GRAPH_ENGINE_H
+#define GRAPH_ENGINE_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include "omp.h"
+#include "pagerank-cpu.h"
+
+// One gather-apply sweep from values_in to values_out. Returns the sum of
+// prog.delta over all rows.
+template <typename Program, typename Offset>
+inline double host_graph_gather_apply(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                      const typename Program::value_type *values_in,
+                                      typename Program::value_type *values_out,
+                                      const Program &prog, int array_length,
+                                      const std::vector<graph_partition> &parts)
+{
+  typedef typename Program::value_type value_type;
+  const int nr_parts = (int)parts.size();
+
+  std::vector<int>        carry_row(nr_parts, -1);
+  std::vector<value_type> carry(nr_parts, prog.identity());
+  std::vector<int>        tail_row(nr_parts, -1);
+  std::vector<value_type> tail(nr_parts, prog.identity());
+  std::vector<double>     part_delta(nr_parts, 0.0);
+
+  #pragma omp parallel for num_threads(nr_parts) schedule(static, 1)
+  for(int t = 0; t < nr_parts; t++)
+  {
+    const graph_partition &p = parts[t];
+    unsigned int i = p.row_begin;
+    double d = 0.0;
+
+    // leading piece of a row owned by an earlier thread
+    if(i < (unsigned int)array_length && graph_indices[i] < p.edge_begin)
+    {
+      Offset stop = (Offset)std::min((graph_offset_t)graph_indices[i+1], p.edge_end);
+      value_type g = prog.identity();
+      for(Offset j = (Offset)p.edge_begin; j < stop; j++)
+      {
+        g = prog.combine(g, prog.gather(values_in, graph_edges[j], j));
+      }
+      carry_row[t] = i;
+      carry[t] = g;
+      i++;
+    }
+
+    for(; i < (unsigned int)array_length; i++)
+    {
+      Offset start = graph_indices[i];
+      if(start >= p.edge_end && t != nr_parts - 1) break;
+      Offset stop = graph_indices[i+1];
+      value_type g = prog.identity();
+      if(stop > p.edge_end)
+      {
+        // our last row continues into the next partition
+        for(Offset j = start; j < (Offset)p.edge_end; j++)
+        {
+          g = prog.combine(g, prog.gather(values_in, graph_edges[j], j));
+        }
+        tail_row[t] = i;
+        tail[t] = g;
+        break;
+      }
+      for(Offset j = start; j < stop; j++)
+      {
+        g = prog.combine(g, prog.gather(values_in, graph_edges[j], j));
+      }
+      values_out[i] = prog.apply(i, g, values_in);
+      d += prog.delta(values_in[i], values_out[i]);
+    }
+    part_delta[t] = d;
+  }
+
+  // finish the split rows with the pieces gathered by the following threads
+  double delta = 0.0;
+  for(int t = 0; t < nr_parts; t++)
+  {
+    delta += part_delta[t];
+    if(tail_row[t] < 0) continue;
+    value_type g = tail[t];
+    for(int u = t + 1; u < nr_parts && carry_row[u] == tail_row[t]; u++)
+    {
+      g = prog.combine(g, carry[u]);
+    }
+    unsigned int i = tail_row[t];
+    values_out[i] = prog.apply(i, g, values_in);
+    delta += prog.delta(values_in[i], values_out[i]);
+  }
+  return delta;
+}
+
+// Run a vertex program until the summed delta of a sweep is at most
+// tolerance (0 for programs that count changed vertices) or max_iterations
+// sweeps are done. values holds the start state on entry and the result on
+// exit. Returns the number of sweeps.
+template <typename Program, typename Offset>
+inline int host_graph_run_program(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                  typename Program::value_type *values, const Program &prog,
+                                  int max_iterations, double tolerance, int array_length)
+{
+  typedef typename Program::value_type value_type;
+  std::vector<graph_partition> parts;
+  host_graph_partition(graph_indices, array_length, omp_get_max_threads(), parts);
+  std::vector<value_type> next(values, values + array_length);
+  value_type *in = values, *out = &next[0];
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    double delta = host_graph_gather_apply(graph_indices, graph_edges, in, out, prog, array_length, parts);
+    std::swap(in, out);
+    iter++;
+    if(delta <= tolerance) break;
+  }
+  if(in != values) std::copy(in, in + array_length, values);
+  return iter;
+}
+
+// PageRank as a vertex program; one sweep matches host_graph_propagate.
+struct pagerank_program
+{
+  typedef float value_type;
+  const float *inv_edges_per_node;
+  float teleport, damping;
+
+  pagerank_program(const float *inv, float d, int array_length)
+    : inv_edges_per_node(inv), teleport((1.f - d)/(float)array_length), damping(d) {}
+  float identity() const { return 0.f; }
+  float gather(const float *in, graph_node_t src, graph_offset_t) const { return in[src]*inv_edges_per_node[src]; }
+  float combine(float a, float b) const { return a + b; }
+  float apply(unsigned int, float sum, const float *) const { return teleport + damping*sum; }
+  double delta(float before, float after) const { return fabs(after - before); }
+};
+
+// Connected components by min-label propagation. Run it on a symmetric
+// graph (host_graph_symmetrize) with labels[i] = i to get weak components.
+struct components_program
+{
+  typedef unsigned int value_type;
+  unsigned int identity() const { return std::numeric_limits<unsigned int>::max(); }
+  unsigned int gather(const unsigned int *in, graph_node_t src, graph_offset_t) const { return in[src]; }
+  unsigned int combine(unsigned int a, unsigned int b) const { return std::min(a, b); }
+  unsigned int apply(unsigned int i, unsigned int label, const unsigned int *in) const { return std::min(in[i], label); }
+  double delta(unsigned int before, unsigned int after) const { return before != after ? 1.0 : 0.0; }
+};
+
+// Bellman-Ford style relaxation along the links: dist[i] = min over the
+// in-links j of dist[src] + edge_weights[j]. Without weights every link
+// costs 1, which gives BFS hop counts. Start with 0 at the sources and
+// infinity elsewhere.
+struct sssp_program
+{
+  typedef float value_type;
+  const float *edge_weights;
+
+  explicit sssp_program(const float *weights = 0) : edge_weights(weights) {}
+  float identity() const { return std::numeric_limits<float>::infinity(); }
+  float gather(const float *in, graph_node_t src, graph_offset_t j) const { return in[src] + (edge_weights ? edge_weights[j] : 1.f); }
+  float combine(float a, float b) const { return std::min(a, b); }
+  float apply(unsigned int i, float dist, const float *in) const { return std::min(in[i], dist); }
+  double delta(float before, float after) const { return before != after ? 1.0 : 0.0; }
+};
+
+// Plain sum over the in-links, the building block of HITS.
+struct sum_program
+{
+  typedef float value_type;
+  float identity() const { return 0.f; }
+  float gather(const float *in, graph_node_t src, graph_offset_t) const { return in[src]; }
+  float combine(float a, float b) const { return a + b; }
+  float apply(unsigned int, float sum, const float *) const { return sum; }
+  double delta(float before, float after) const { return fabs(after - before); }
+};
+
+// Undirected view of the graph: row i lists both the in- and out-links of
+// node i.
+template <typename Offset>
+inline void host_graph_symmetrize(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                  std::vector<Offset> &sym_indices, std::vector<graph_node_t> &sym_edges)
+{
+  std::vector<Offset> out_indices;
+  std::vector<graph_node_t> out_edges;
+  host_graph_transpose(graph_indices, graph_edges, array_length, out_indices, out_edges);
+  sym_indices.resize(array_length + 1);
+  sym_indices[0] = 0;
+  for(int i = 0; i < array_length; i++)
+  {
+    sym_indices[i+1] = sym_indices[i] + (graph_indices[i+1] - graph_indices[i]) + (out_indices[i+1] - out_indices[i]);
+  }
+  sym_edges.resize(sym_indices[array_length]);
+  if(sym_edges.empty()) return;
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    graph_node_t *dst = &sym_edges[0] + sym_indices[i];
+    dst = std::copy(graph_edges + graph_indices[i], graph_edges + graph_indices[i+1], dst);
+    std::copy(&out_edges[0] + out_indices[i], &out_edges[0] + out_indices[i+1], dst);
+  }
+}
+
+// Scale to unit L2 norm; returns the L1 change against previous (if given).
+inline double host_hits_normalize(float *values, const float *previous, int array_length)
+{
+  double norm = 0.0;
+  #pragma omp parallel for schedule(static) reduction(+:norm)
+  for(int i = 0; i < array_length; i++) norm += (double)values[i]*values[i];
+  float scale = norm > 0.0 ? (float)(1.0/sqrt(norm)) : 0.f;
+  double change = 0.0;
+  #pragma omp parallel for schedule(static) reduction(+:change)
+  for(int i = 0; i < array_length; i++)
+  {
+    values[i] *= scale;
+    if(previous) change += fabs(values[i] - previous[i]);
+  }
+  return change;
+}
+
+// HITS: authority = sum of the hub scores linking in (the CSR as is),
+// hub = sum of the authority scores linked to (the transposed CSR). Both
+// gathers go through the engine. hub and authority are initialised here.
+// Returns the number of rounds.
+template <typename Offset>
+inline int host_graph_hits(const Offset *graph_indices, const graph_node_t *graph_edges,
+                           const std::vector<Offset> &out_indices, const std::vector<graph_node_t> &out_edges,
+                           float *hub, float *authority, int max_iterations, double tolerance, int array_length)
+{
+  std::vector<graph_partition> in_parts, out_parts;
+  host_graph_partition(graph_indices, array_length, omp_get_max_threads(), in_parts);
+  host_graph_partition(&out_indices[0], array_length, omp_get_max_threads(), out_parts);
+  std::vector<float> previous(array_length, 0.f);
+  std::fill(hub, hub + array_length, 1.f/sqrtf((float)array_length));
+  std::fill(authority, authority + array_length, 0.f);
+  sum_program prog;
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    host_graph_gather_apply(graph_indices, graph_edges, hub, authority, prog, array_length, in_parts);
+    double change = host_hits_normalize(authority, &previous[0], array_length);
+    std::copy(authority, authority + array_length, previous.begin());
+    host_graph_gather_apply(&out_indices[0], out_edges.empty() ? 0 : &out_edges[0], authority, hub, prog, array_length, out_parts);
+    host_hits_normalize(hub, 0, array_length);
+    iter++;
+    if(change < tolerance) break;
+  }
+  return iter;
+}
+
+#endif
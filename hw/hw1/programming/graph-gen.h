@@ -0,0 +1,142 @@
+// Parallel synthetic graphs for the PageRank CSR.
+//
+// Both generators draw from a counter-based RNG: every edge is a pure
+// function of (seed, edge number), so edges can be produced in any order,
+// by any number of threads or ranks, and produced again later without
+// storing them.
+//
+//   uniform - the shape of the pagerank.cu generator: node i has
+//             i % (2*avg_edges-1) + 1 in-links from uniformly random pages,
+//             weighted by 1/(its own number of in-links)
+//   R-MAT   - recursive matrix (Chakrabarti et al.) with the Graph500
+//             probabilities, 2^scale nodes and avg_edges links per node;
+//             skewed power-law degrees, weighted by 1/out-degree
+
+#ifndef GRAPH_GEN_H
+#define GRAPH_GEN_H
+
+#include <vector>
+#include <algorithm>
+#include "omp.h"
+#include "graph-types.h"
+
+// splitmix64 finalizer
+inline unsigned long long host_mix64(unsigned long long x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Random 64-bit value number k of stream seed.
+inline unsigned long long host_random(unsigned long long seed, unsigned long long k)
+{
+  return host_mix64(seed * 0x9e3779b97f4a7c15ULL + k);
+}
+
+// Offset of row i in the uniform graph, in closed form.
+inline graph_offset_t host_uniform_edges_before(long long i, int avg_edges)
+{
+  long long cycle = 2*avg_edges - 1;
+  long long r = i % cycle;
+  return (graph_offset_t)(i / cycle) * avg_edges * cycle + r*(r+1)/2;
+}
+
+inline void host_graph_generate_uniform(int array_length, int avg_edges, unsigned long long seed,
+                                        std::vector<graph_offset_t> &graph_indices, std::vector<graph_node_t> &graph_edges,
+                                        std::vector<float> &inv_edges_per_node)
+{
+  graph_indices.resize(array_length + 1);
+  inv_edges_per_node.resize(array_length);
+  graph_edges.resize(host_uniform_edges_before(array_length, avg_edges));
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i <= array_length; i++)
+  {
+    graph_indices[i] = host_uniform_edges_before(i, avg_edges);
+  }
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < array_length; i++)
+  {
+    inv_edges_per_node[i] = 1.f/(float)(graph_indices[i+1] - graph_indices[i]);
+    for(graph_offset_t j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      graph_edges[j] = (graph_node_t)(host_random(seed, j) % (unsigned long long)array_length);
+    }
+  }
+}
+
+// Link number k of an R-MAT graph: one quadrant choice per bit, drawn with
+// 16 bits of randomness each (four levels per RNG call), then the ids are
+// scrambled with an odd multiplier (a bijection mod 2^scale) so that the
+// hubs aren't all packed at the low ids.
+inline void host_rmat_edge(int scale, unsigned long long seed, unsigned long long k, graph_node_t &src, graph_node_t &dst)
+{
+  // a = 0.57, a+b = 0.76, a+b+c = 0.95 in units of 2^-16
+  const unsigned int a = 37356, ab = 49807, abc = 62259;
+  unsigned long long s = 0, d = 0, bits = 0;
+  for(int level = 0; level < scale; level++)
+  {
+    if((level & 3) == 0) bits = host_random(seed, k*16 + (level >> 2));
+    unsigned int r = (unsigned int)(bits & 0xffff);
+    bits >>= 16;
+    // quadrants a, b, c, d are (0,0), (0,1), (1,0), (1,1); no branches,
+    // the choice is random and would mispredict every other level
+    unsigned int sbit = r >= ab;
+    unsigned int dbit = (r >= a) ^ sbit ^ (r >= abc);
+    s = (s << 1) | sbit;
+    d = (d << 1) | dbit;
+  }
+  const unsigned long long mask = (1ULL << scale) - 1;
+  src = (graph_node_t)((s * 0x9e3779b97f4a7c15ULL) & mask);
+  dst = (graph_node_t)((d * 0x9e3779b97f4a7c15ULL) & mask);
+}
+
+// Two passes over the same counter stream: count the in-links of every row,
+// then generate the links again and scatter them. Rows are sorted
+// afterwards so the result doesn't depend on the thread interleaving.
+inline void host_graph_generate_rmat(int scale, int avg_edges, unsigned long long seed,
+                                     std::vector<graph_offset_t> &graph_indices, std::vector<graph_node_t> &graph_edges,
+                                     std::vector<float> &inv_edges_per_node)
+{
+  const int array_length = 1 << scale;
+  const long long nr_edges = (long long)array_length * avg_edges;
+  std::vector<graph_offset_t> count(array_length + 1, 0);
+  std::vector<unsigned int> out_degree(array_length, 0);
+
+  #pragma omp parallel for schedule(static)
+  for(long long k = 0; k < nr_edges; k++)
+  {
+    graph_node_t src, dst;
+    host_rmat_edge(scale, seed, k, src, dst);
+    #pragma omp atomic
+    count[dst+1]++;
+    #pragma omp atomic
+    out_degree[src]++;
+  }
+  for(int i = 0; i < array_length; i++) count[i+1] += count[i];
+  graph_indices.swap(count);
+
+  std::vector<graph_offset_t> cursor(graph_indices.begin(), graph_indices.end() - 1);
+  graph_edges.resize(nr_edges);
+  #pragma omp parallel for schedule(static)
+  for(long long k = 0; k < nr_edges; k++)
+  {
+    graph_node_t src, dst;
+    host_rmat_edge(scale, seed, k, src, dst);
+    graph_offset_t slot;
+    #pragma omp atomic capture
+    slot = cursor[dst]++;
+    graph_edges[slot] = src;
+  }
+
+  inv_edges_per_node.resize(array_length);
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    std::sort(graph_edges.begin() + graph_indices[i], graph_edges.begin() + graph_indices[i+1]);
+    inv_edges_per_node[i] = out_degree[i] ? 1.f/(float)out_degree[i] : 0.f;
+  }
+}
+
+#endif
@@ -0,0 +1,366 @@
+// Loading real link graphs into the PageRank CSR.
+//
+// Text formats:
+//   edge list      - one "src dst" pair per line, lines starting with '#'
+//                    or '%' are comments, ids are 0-based
+//   Matrix Market  - "%%MatrixMarket matrix coordinate ..." header, entry
+//                    "i j [value]" (1-based) is a link from j to i, i.e. the
+//                    same orientation as row i of the CSR; symmetric files
+//                    get both directions
+//
+// Text files are parsed in parallel chunks and the CSR is built with a
+// parallel counting sort. The result can be saved in a small binary format
+// that is mmapped directly on later runs.
+
+#ifndef GRAPH_IO_H
+#define GRAPH_IO_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "omp.h"
+#include "graph-types.h"
+
+// Read-only mapping of a whole file.
+struct mapped_file
+{
+  const char *data;
+  size_t size;
+};
+
+inline bool host_map_file(const char *filename, mapped_file &file)
+{
+  file.data = 0;
+  file.size = 0;
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0) { close(fd); return false; }
+  file.size = (size_t)st.st_size;
+  if(file.size > 0)
+  {
+    void *p = mmap(0, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) { close(fd); return false; }
+    madvise(p, file.size, MADV_SEQUENTIAL);
+    file.data = (const char *)p;
+  }
+  close(fd);
+  return true;
+}
+
+inline void host_unmap_file(mapped_file &file)
+{
+  if(file.data) munmap((void *)file.data, file.size);
+  file.data = 0;
+  file.size = 0;
+}
+
+// Parse the unsigned integer at p, skipping leading blanks. Returns false
+// if the line ends first.
+inline bool host_parse_uint(const char *&p, const char *end, unsigned long long &value)
+{
+  while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  if(p == end || *p < '0' || *p > '9') return false;
+  unsigned long long v = 0;
+  while(p < end && *p >= '0' && *p <= '9') v = v*10 + (unsigned long long)(*p++ - '0');
+  value = v;
+  return true;
+}
+
+inline const char *host_next_line(const char *p, const char *end)
+{
+  const char *nl = (const char *)memchr(p, '\n', end - p);
+  return nl ? nl + 1 : end;
+}
+
+// Parse "a b ..." pairs from [begin, end) in parallel. Every thread takes a
+// byte range, moved forward to the next line start, and collects its own
+// pairs; the pieces are concatenated in order.
+inline void host_parse_pairs(const char *begin, const char *end, std::vector<unsigned long long> &first,
+                             std::vector<unsigned long long> &second)
+{
+  int nr_threads = omp_get_max_threads();
+  std::vector<std::vector<unsigned long long> > local_first(nr_threads), local_second(nr_threads);
+  size_t length = end - begin;
+
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    int t = omp_get_thread_num();
+    int nt = omp_get_num_threads();
+    const char *p    = begin + length * t / nt;
+    const char *stop = begin + length * (t+1) / nt;
+    // a line belongs to the thread its first byte falls into
+    if(p != begin && p[-1] != '\n') p = host_next_line(p, end);
+    while(p < stop)
+    {
+      const char *line_end = host_next_line(p, end);
+      unsigned long long a, b;
+      if(*p != '#' && *p != '%' && host_parse_uint(p, line_end, a) && host_parse_uint(p, line_end, b))
+      {
+        local_first[t].push_back(a);
+        local_second[t].push_back(b);
+      }
+      p = line_end;
+    }
+  }
+
+  size_t total = 0;
+  for(int t = 0; t < nr_threads; t++) total += local_first[t].size();
+  first.clear();
+  second.clear();
+  first.reserve(total);
+  second.reserve(total);
+  for(int t = 0; t < nr_threads; t++)
+  {
+    first.insert(first.end(), local_first[t].begin(), local_first[t].end());
+    second.insert(second.end(), local_second[t].begin(), local_second[t].end());
+  }
+}
+
+// Parallel counting sort of the links by row (destination). Row counts are
+// taken with atomics, offsets with a parallel prefix sum, and the sources
+// are scattered through atomic cursors. Each row is sorted afterwards so
+// the result doesn't depend on the thread interleaving.
+inline void host_graph_build_csr(const std::vector<unsigned long long> &rows, const std::vector<unsigned long long> &cols,
+                                 int array_length, std::vector<graph_offset_t> &graph_indices, std::vector<graph_node_t> &graph_edges)
+{
+  const long long nr_edges = (long long)rows.size();
+  std::vector<graph_offset_t> count(array_length + 1, 0);
+
+  #pragma omp parallel for schedule(static)
+  for(long long k = 0; k < nr_edges; k++)
+  {
+    #pragma omp atomic
+    count[rows[k]+1]++;
+  }
+
+  // two-level prefix sum: per-thread block sums, then a serial scan of the
+  // block sums, then each block adds its offset
+  int nr_threads = omp_get_max_threads();
+  std::vector<graph_offset_t> block_sum(nr_threads + 1, 0);
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    int t = omp_get_thread_num();
+    int nt = omp_get_num_threads();
+    long long first = (long long)(array_length + 1) * t / nt;
+    long long last  = (long long)(array_length + 1) * (t+1) / nt;
+    graph_offset_t sum = 0;
+    for(long long i = first; i < last; i++) { sum += count[i]; count[i] = sum; }
+    block_sum[t+1] = sum;
+    #pragma omp barrier
+    #pragma omp single
+    for(int b = 0; b < nt; b++) block_sum[b+1] += block_sum[b];
+    for(long long i = first; i < last; i++) count[i] += block_sum[t];
+  }
+  graph_indices.swap(count);
+
+  std::vector<graph_offset_t> cursor(graph_indices.begin(), graph_indices.end() - 1);
+  graph_edges.resize(nr_edges);
+  #pragma omp parallel for schedule(static)
+  for(long long k = 0; k < nr_edges; k++)
+  {
+    graph_offset_t slot;
+    #pragma omp atomic capture
+    slot = cursor[rows[k]]++;
+    graph_edges[slot] = (graph_node_t)cols[k];
+  }
+
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    std::sort(graph_edges.begin() + graph_indices[i], graph_edges.begin() + graph_indices[i+1]);
+  }
+}
+
+// Append the mirror (col, row) of every off-diagonal pair, in parallel:
+// every thread counts the off-diagonal pairs of its block, a scan over the
+// counts gives each block its place behind the stored pairs, and the
+// blocks then write their mirrors there. The order is the same as a serial
+// loop over the pairs would give.
+inline void host_graph_mirror_pairs(std::vector<unsigned long long> &rows, std::vector<unsigned long long> &cols)
+{
+  const size_t stored = rows.size();
+  int nr_threads = omp_get_max_threads();
+  std::vector<size_t> block_start(nr_threads + 1, 0);
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    int t = omp_get_thread_num();
+    int nt = omp_get_num_threads();
+    size_t first = stored * t / nt;
+    size_t last  = stored * (t+1) / nt;
+    size_t count = 0;
+    for(size_t k = first; k < last; k++) count += rows[k] != cols[k];
+    block_start[t+1] = count;
+    #pragma omp barrier
+    #pragma omp single
+    {
+      block_start[0] = stored;
+      for(int b = 0; b < nt; b++) block_start[b+1] += block_start[b];
+      rows.resize(block_start[nt]);
+      cols.resize(block_start[nt]);
+    }
+    size_t out = block_start[t];
+    for(size_t k = first; k < last; k++)
+    {
+      if(rows[k] != cols[k]) { rows[out] = cols[k]; cols[out] = rows[k]; out++; }
+    }
+  }
+}
+
+// Load an edge list or Matrix Market file. Returns false if the file can't
+// be read or node ids don't fit in 31 bits.
+inline bool host_graph_load_text(const char *filename, int &array_length,
+                                 std::vector<graph_offset_t> &graph_indices, std::vector<graph_node_t> &graph_edges)
+{
+  mapped_file file;
+  if(!host_map_file(filename, file)) return false;
+  const char *p   = file.data;
+  const char *end = file.data + file.size;
+
+  std::vector<unsigned long long> first, second;
+  unsigned long long nr_rows = 0;
+  bool matrix_market = file.size >= 14 && strncmp(p, "%%MatrixMarket", 14) == 0;
+  bool symmetric = false;
+  if(matrix_market)
+  {
+    std::string banner(p, host_next_line(p, end));
+    symmetric = banner.find("symmetric") != std::string::npos;
+    // skip the comments, the size line gives the dimensions
+    while(p < end && *p == '%') p = host_next_line(p, end);
+    unsigned long long nr_cols, nnz;
+    if(!host_parse_uint(p, end, nr_rows) || !host_parse_uint(p, end, nr_cols) || !host_parse_uint(p, end, nnz))
+    {
+      host_unmap_file(file);
+      return false;
+    }
+    nr_rows = std::max(nr_rows, nr_cols);
+    p = host_next_line(p, end);
+  }
+  host_parse_pairs(p, end, first, second);
+  host_unmap_file(file);
+
+  // rows are destinations, columns the linking pages
+  std::vector<unsigned long long> &rows = matrix_market ? first : second;
+  std::vector<unsigned long long> &cols = matrix_market ? second : first;
+  unsigned long long max_id = 0;
+  #pragma omp parallel for reduction(max:max_id)
+  for(long long k = 0; k < (long long)rows.size(); k++)
+  {
+    unsigned long long m = std::max(rows[k], cols[k]);
+    if(m > max_id) max_id = m;
+  }
+  if(matrix_market)
+  {
+    if(!rows.empty() && (max_id > nr_rows || std::min(*std::min_element(rows.begin(), rows.end()),
+                                                        *std::min_element(cols.begin(), cols.end())) == 0))
+      return false;
+    #pragma omp parallel for
+    for(long long k = 0; k < (long long)rows.size(); k++) { rows[k]--; cols[k]--; }
+    // symmetric files only store the lower triangle
+    if(symmetric) host_graph_mirror_pairs(rows, cols);
+  }
+  else
+  {
+    nr_rows = rows.empty() ? 0 : max_id + 1;
+  }
+  if(nr_rows >= 0x7fffffffULL) return false;
+
+  array_length = (int)nr_rows;
+  host_graph_build_csr(rows, cols, array_length, graph_indices, graph_edges);
+  return true;
+}
+
+// 1/out-degree of every node, 0 for pages without links.
+template <typename Offset>
+inline void host_graph_inv_out_degree(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                      float *inv_edges_per_node)
+{
+  std::vector<unsigned int> out_degree(array_length, 0);
+  for(Offset j = 0; j < graph_indices[array_length]; j++) out_degree[graph_edges[j]]++;
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < array_length; i++)
+  {
+    inv_edges_per_node[i] = out_degree[i] ? 1.f/(float)out_degree[i] : 0.f;
+  }
+}
+
+// Binary CSR cache. A fixed header followed by graph_indices and
+// graph_edges as they are in memory, so a mapped file can be used in place.
+// Bump GRAPH_FILE_VERSION whenever the layout changes. Version 2 stores
+// 64-bit edge offsets; the header size keeps both arrays 8-byte aligned.
+#define GRAPH_FILE_MAGIC   "PRCSR\0\0\0"
+#define GRAPH_FILE_VERSION 2
+
+struct graph_file_header
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t offset_bytes;  // sizeof one graph_indices entry
+  uint32_t node_bytes;    // sizeof one graph_edges entry
+  uint32_t reserved;
+  uint64_t nr_nodes;
+  uint64_t nr_edges;
+};
+
+inline bool host_graph_save_binary(const char *filename, int array_length,
+                                   const graph_offset_t *graph_indices, const graph_node_t *graph_edges)
+{
+  FILE *f = fopen(filename, "wb");
+  if(!f) return false;
+  graph_file_header header;
+  memcpy(header.magic, GRAPH_FILE_MAGIC, 8);
+  header.version      = GRAPH_FILE_VERSION;
+  header.offset_bytes = sizeof(graph_offset_t);
+  header.node_bytes   = sizeof(graph_node_t);
+  header.reserved     = 0;
+  header.nr_nodes     = array_length;
+  header.nr_edges     = graph_indices[array_length];
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+         && fwrite(graph_indices, sizeof(graph_offset_t), array_length + 1, f) == (size_t)array_length + 1
+         && fwrite(graph_edges, sizeof(graph_node_t), header.nr_edges, f) == header.nr_edges;
+  return fclose(f) == 0 && ok;
+}
+
+// A CSR living in a mapped binary cache file.
+struct mapped_graph
+{
+  mapped_file file;
+  int array_length;
+  const graph_offset_t *graph_indices;
+  const graph_node_t *graph_edges;
+};
+
+inline bool host_graph_map_binary(const char *filename, mapped_graph &g)
+{
+  if(!host_map_file(filename, g.file)) return false;
+  graph_file_header header;
+  if(g.file.size < sizeof(header)) { host_unmap_file(g.file); return false; }
+  memcpy(&header, g.file.data, sizeof(header));
+  if(memcmp(header.magic, GRAPH_FILE_MAGIC, 8) != 0 || header.version != GRAPH_FILE_VERSION ||
+     header.offset_bytes != sizeof(graph_offset_t) || header.node_bytes != sizeof(graph_node_t) ||
+     g.file.size != sizeof(header) + (header.nr_nodes + 1) * sizeof(graph_offset_t) + header.nr_edges * sizeof(graph_node_t))
+  {
+    host_unmap_file(g.file);
+    return false;
+  }
+  g.array_length  = (int)header.nr_nodes;
+  g.graph_indices = (const graph_offset_t *)(g.file.data + sizeof(header));
+  g.graph_edges   = (const graph_node_t *)(g.graph_indices + header.nr_nodes + 1);
+  return true;
+}
+
+inline void host_graph_unmap_binary(mapped_graph &g)
+{
+  host_unmap_file(g.file);
+  g.graph_indices = 0;
+  g.graph_edges   = 0;
+}
+
+#endif
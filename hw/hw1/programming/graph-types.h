@@ -0,0 +1,14 @@
+// Index types of the CSR shared by the PageRank code.
+//
+// Edge offsets (graph_indices) are 64-bit so a graph may have more than 4G
+// links; node ids (graph_edges) stay 32-bit, which keeps the edge stream
+// and the SIMD gathers the same size. The host traversals are templates on
+// the offset type, so a CSR with 32-bit offsets works with them as well.
+
+#ifndef GRAPH_TYPES_H
+#define GRAPH_TYPES_H
+
+typedef unsigned long long graph_offset_t;
+typedef unsigned int       graph_node_t;
+
+#endif
@@ -0,0 +1,1382 @@
+// Multithreaded CPU versions of the PageRank propagate step.
+//
+// These work on the same CSR layout as host_graph_propagate in pagerank.cu
+// (graph_indices has array_length+1 entries, graph_edges holds the source
+// node of every incoming link) and only need a C++ compiler with OpenMP,
+// so they can be built without nvcc.
+
+#ifndef PAGERANK_CPU_H
+#define PAGERANK_CPU_H
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+#include "omp.h"
+#include "graph-types.h"
+
+// Work split for one thread. Threads get an equal share of the *edges*
+// rather than of the nodes, so a hub node with many in-links can be spread
+// across several threads.
+//
+// A thread owns (writes) every row whose first edge lies in
+// [edge_begin, edge_end); the last thread also owns trailing empty rows.
+// If its last owned row runs past edge_end, the partial sum is finished by
+// the following thread(s), which hand back their share through carry_sum.
+struct graph_partition
+{
+  graph_offset_t edge_begin;
+  graph_offset_t edge_end;
+  unsigned int row_begin;   // first row touched, may be owned by an earlier thread
+};
+
+// Find the first row that has edges at or after e: either the row that
+// starts exactly at e or the row that contains e.
+template <typename Offset>
+inline unsigned int host_graph_find_row(const Offset *graph_indices, int array_length, graph_offset_t e)
+{
+  unsigned int r = (unsigned int)(std::lower_bound(graph_indices, graph_indices + array_length + 1, (Offset)e) - graph_indices);
+  if(graph_indices[r] != e) r--;
+  return r;
+}
+
+// Split the edge range into nr_parts equal pieces with a binary search
+// over graph_indices for each boundary.
+template <typename Offset>
+inline void host_graph_partition(const Offset *graph_indices, int array_length, int nr_parts, std::vector<graph_partition> &parts)
+{
+  graph_offset_t nr_edges = graph_indices[array_length];
+  parts.resize(nr_parts);
+  for(int t = 0; t < nr_parts; t++)
+  {
+    graph_partition &p = parts[t];
+    p.edge_begin = nr_edges * t / nr_parts;
+    p.edge_end   = nr_edges * (t+1) / nr_parts;
+    p.row_begin  = host_graph_find_row(graph_indices, array_length, p.edge_begin);
+  }
+}
+
+// Edge-balanced multithreaded propagate. parts must come from
+// host_graph_partition with one entry per OpenMP thread.
+template <typename Offset>
+inline void host_graph_propagate_omp(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                     const float *graph_nodes_in, float *graph_nodes_out,
+                                     const float *inv_edges_per_node, int array_length,
+                                     const std::vector<graph_partition> &parts)
+{
+  const int nr_parts = (int)parts.size();
+  const float teleport = 0.5f/(float)array_length;
+
+  // per-thread partial sums for rows that straddle a partition boundary
+  std::vector<int>   carry_row(nr_parts, -1);
+  std::vector<float> carry_sum(nr_parts, 0.f);
+  std::vector<int>   tail_row(nr_parts, -1);
+
+  #pragma omp parallel for num_threads(nr_parts) schedule(static, 1)
+  for(int t = 0; t < nr_parts; t++)
+  {
+    const graph_partition &p = parts[t];
+    unsigned int i = p.row_begin;
+
+    // leading piece of a row owned by an earlier thread
+    if(i < (unsigned int)array_length && graph_indices[i] < p.edge_begin)
+    {
+      Offset stop = (Offset)std::min((graph_offset_t)graph_indices[i+1], p.edge_end);
+      float sum = 0.f;
+      for(Offset j = (Offset)p.edge_begin; j < stop; j++)
+      {
+        sum += graph_nodes_in[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
+      }
+      carry_row[t] = i;
+      carry_sum[t] = sum;
+      i++;
+    }
+
+    for(; i < (unsigned int)array_length; i++)
+    {
+      Offset start = graph_indices[i];
+      if(start >= p.edge_end && t != nr_parts - 1) break;
+      Offset stop = graph_indices[i+1];
+      float sum = 0.f;
+      if(stop > p.edge_end)
+      {
+        // our last row continues into the next partition
+        for(Offset j = start; j < (Offset)p.edge_end; j++)
+        {
+          sum += graph_nodes_in[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
+        }
+        graph_nodes_out[i] = sum;
+        tail_row[t] = i;
+        break;
+      }
+      for(Offset j = start; j < stop; j++)
+      {
+        sum += graph_nodes_in[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
+      }
+      graph_nodes_out[i] = teleport + 0.5f*sum;
+    }
+  }
+
+  // merge the partial sums of split rows, then apply the damping
+  for(int t = 0; t < nr_parts; t++)
+  {
+    if(carry_row[t] >= 0) graph_nodes_out[carry_row[t]] += carry_sum[t];
+  }
+  for(int t = 0; t < nr_parts; t++)
+  {
+    if(tail_row[t] >= 0) graph_nodes_out[tail_row[t]] = teleport + 0.5f*graph_nodes_out[tail_row[t]];
+  }
+}
+
+// Same ping-pong scheme as host_graph_iterate; the partition is computed
+// once and reused for every sweep.
+template <typename Offset>
+inline void host_graph_iterate_omp(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                   float *graph_nodes_A, float *graph_nodes_B,
+                                   const float *inv_edges_per_node, int nr_iterations, int array_length)
+{
+  assert((nr_iterations % 2) == 0);
+  std::vector<graph_partition> parts;
+  host_graph_partition(graph_indices, array_length, omp_get_max_threads(), parts);
+  for(int iter = 0; iter < nr_iterations; iter+=2)
+  {
+    host_graph_propagate_omp(graph_indices, graph_edges, graph_nodes_A, graph_nodes_B, inv_edges_per_node, array_length, parts);
+    host_graph_propagate_omp(graph_indices, graph_edges, graph_nodes_B, graph_nodes_A, inv_edges_per_node, array_length, parts);
+  }
+}
+
+// Size of the per-core L2 cache in bytes, or a conservative guess if the
+// system doesn't tell us.
+inline size_t host_l2_bytes()
+{
+  long l2 = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  if(l2 <= 0) l2 = 256 << 10;
+  return (size_t)l2;
+}
+
+// Cache-segmented copy of the CSR. The source nodes are cut into ranges of
+// segment_size nodes and every edge is bucketed by the range its source
+// falls into. Each segment is a small CSR of its own that only lists the
+// rows with at least one edge in that range, so one pass over a segment
+// gathers from a slice of graph_nodes_in/inv_edges_per_node that stays in
+// cache.
+struct segmented_graph
+{
+  int nr_segments;
+  unsigned int segment_size;
+  std::vector<graph_offset_t> segment_rows; // nr_segments+1 offsets into rows
+  std::vector<graph_node_t> rows;           // destination row of each segment row
+  std::vector<graph_offset_t> indices;      // rows.size()+1 offsets into edges
+  std::vector<graph_node_t> edges;
+};
+
+// Pick a segment size so that the gathered slice of both per-node arrays
+// takes about a quarter of L2, leaving room for the streamed index, edge
+// and output data.
+inline unsigned int host_graph_default_segment_size()
+{
+  size_t nodes = host_l2_bytes() / (4 * 2 * sizeof(float));
+  return (unsigned int)std::max(nodes, (size_t)1024);
+}
+
+// Preprocessing step: bucket the edges of the CSR by source range. Edge
+// order inside a row is kept, and rows stay sorted inside each segment.
+template <typename Offset>
+inline void host_graph_segment(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                               unsigned int segment_size, segmented_graph &seg)
+{
+  assert(segment_size > 0);
+  seg.segment_size = segment_size;
+  seg.nr_segments  = (int)((array_length + segment_size - 1) / segment_size);
+  if(seg.nr_segments == 0) seg.nr_segments = 1;
+
+  // count rows and edges per segment
+  std::vector<graph_offset_t> seg_edges(seg.nr_segments, 0);
+  std::vector<graph_offset_t> seg_rows(seg.nr_segments, 0);
+  std::vector<int> last_row(seg.nr_segments, -1);
+  for(int i = 0; i < array_length; i++)
+  {
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      unsigned int s = graph_edges[j] / segment_size;
+      seg_edges[s]++;
+      if(last_row[s] != i) { last_row[s] = i; seg_rows[s]++; }
+    }
+  }
+
+  seg.segment_rows.assign(seg.nr_segments + 1, 0);
+  std::vector<graph_offset_t> row_cursor(seg.nr_segments);
+  std::vector<graph_offset_t> edge_cursor(seg.nr_segments);
+  graph_offset_t nr_edges = 0;
+  for(int s = 0; s < seg.nr_segments; s++)
+  {
+    seg.segment_rows[s+1] = seg.segment_rows[s] + seg_rows[s];
+    row_cursor[s]  = seg.segment_rows[s];
+    edge_cursor[s] = nr_edges;
+    nr_edges += seg_edges[s];
+  }
+  graph_offset_t nr_rows = seg.segment_rows[seg.nr_segments];
+  seg.rows.resize(nr_rows);
+  seg.indices.resize(nr_rows + 1);
+  seg.edges.resize(nr_edges);
+  seg.indices[nr_rows] = nr_edges;
+
+  // scatter, opening a new segment row the first time a row hits a segment
+  std::fill(last_row.begin(), last_row.end(), -1);
+  for(int i = 0; i < array_length; i++)
+  {
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      unsigned int s = graph_edges[j] / segment_size;
+      if(last_row[s] != i)
+      {
+        last_row[s] = i;
+        seg.rows[row_cursor[s]]    = i;
+        seg.indices[row_cursor[s]] = edge_cursor[s];
+        row_cursor[s]++;
+      }
+      seg.edges[edge_cursor[s]++] = graph_edges[j];
+    }
+  }
+}
+
+// Propagate over a segmented graph: each segment adds its partial sums into
+// graph_nodes_out, the damping is applied once all segments are merged.
+// Rows are distinct within a segment, so threads never write the same entry.
+inline void host_graph_propagate_segmented(const segmented_graph &seg, const float *graph_nodes_in, float *graph_nodes_out,
+                                           const float *inv_edges_per_node, int array_length)
+{
+  const float teleport = 0.5f/(float)array_length;
+  const graph_node_t   *rows    = seg.rows.empty()    ? 0 : &seg.rows[0];
+  const graph_offset_t *indices = &seg.indices[0];
+  const graph_node_t   *edges   = seg.edges.empty()   ? 0 : &seg.edges[0];
+
+  #pragma omp parallel
+  {
+    #pragma omp for schedule(static)
+    for(int i = 0; i < array_length; i++)
+    {
+      graph_nodes_out[i] = 0.f;
+    }
+
+    for(int s = 0; s < seg.nr_segments; s++)
+    {
+      long long first = (long long)seg.segment_rows[s];
+      long long last  = (long long)seg.segment_rows[s+1];
+      #pragma omp for schedule(guided)
+      for(long long r = first; r < last; r++)
+      {
+        float sum = 0.f;
+        for(graph_offset_t j = indices[r]; j < indices[r+1]; j++)
+        {
+          sum += graph_nodes_in[edges[j]]*inv_edges_per_node[edges[j]];
+        }
+        graph_nodes_out[rows[r]] += sum;
+      }
+    }
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < array_length; i++)
+    {
+      graph_nodes_out[i] = teleport + 0.5f*graph_nodes_out[i];
+    }
+  }
+}
+
+inline void host_graph_iterate_segmented(const segmented_graph &seg, float *graph_nodes_A, float *graph_nodes_B,
+                                         const float *inv_edges_per_node, int nr_iterations, int array_length)
+{
+  assert((nr_iterations % 2) == 0);
+  for(int iter = 0; iter < nr_iterations; iter+=2)
+  {
+    host_graph_propagate_segmented(seg, graph_nodes_A, graph_nodes_B, inv_edges_per_node, array_length);
+    host_graph_propagate_segmented(seg, graph_nodes_B, graph_nodes_A, inv_edges_per_node, array_length);
+  }
+}
+
+// Bytes moved by one propagate sweep over the plain CSR: the index and edge
+// arrays, one output write, and the two gathers per edge.
+template <typename Offset>
+inline double host_graph_bytes_per_sweep(const Offset *graph_indices, int array_length)
+{
+  double nr_edges = (double)graph_indices[array_length];
+  return (array_length + 1) * sizeof(Offset) + array_length * sizeof(float)
+       + nr_edges * (sizeof(graph_node_t) + 2 * sizeof(float));
+}
+
+// Node reordering. Both orderings return new_id[old] = new. Only the node
+// numbering changes; the edge order inside every row is kept, so running
+// on the reordered graph gives bitwise the same ranks as the original.
+
+// Number of times every node is gathered, i.e. its number of out-links.
+template <typename Offset>
+inline void host_graph_out_degree(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                  std::vector<unsigned int> &out_degree)
+{
+  out_degree.assign(array_length, 0);
+  for(Offset j = 0; j < graph_indices[array_length]; j++)
+  {
+    out_degree[graph_edges[j]]++;
+  }
+}
+
+struct degree_greater
+{
+  const unsigned int *degree;
+  degree_greater(const unsigned int *d) : degree(d) {}
+  bool operator()(unsigned int a, unsigned int b) const { return degree[a] > degree[b]; }
+};
+
+struct degree_less
+{
+  const unsigned int *degree;
+  degree_less(const unsigned int *d) : degree(d) {}
+  bool operator()(unsigned int a, unsigned int b) const { return degree[a] < degree[b]; }
+};
+
+// Degree sort: the most gathered nodes get the lowest ids, so the hot part
+// of the rank vector is small and packed together.
+template <typename Offset>
+inline void host_graph_order_degree(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                    std::vector<unsigned int> &new_id)
+{
+  std::vector<unsigned int> out_degree;
+  host_graph_out_degree(graph_indices, graph_edges, array_length, out_degree);
+  std::vector<unsigned int> order(array_length);
+  for(int i = 0; i < array_length; i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), degree_greater(array_length ? &out_degree[0] : 0));
+  new_id.resize(array_length);
+  for(int i = 0; i < array_length; i++) new_id[order[i]] = i;
+}
+
+// Reverse Cuthill-McKee on the symmetrized link graph: a BFS that visits
+// neighbours by increasing degree, reversed at the end. Linked nodes end up
+// with nearby ids, which keeps the gathers of one row close together.
+template <typename Offset>
+inline void host_graph_order_rcm(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                 std::vector<unsigned int> &new_id)
+{
+  // undirected adjacency: in-links from the CSR plus the transposed out-links
+  std::vector<graph_offset_t> adj_indices(array_length + 1, 0);
+  for(int i = 0; i < array_length; i++)
+  {
+    adj_indices[i+1] += graph_indices[i+1] - graph_indices[i];
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      adj_indices[graph_edges[j]+1]++;
+    }
+  }
+  for(int i = 0; i < array_length; i++) adj_indices[i+1] += adj_indices[i];
+  std::vector<graph_offset_t> cursor(adj_indices.begin(), adj_indices.end() - 1);
+  std::vector<graph_node_t> adj(adj_indices[array_length]);
+  for(int i = 0; i < array_length; i++)
+  {
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      adj[cursor[i]++] = graph_edges[j];
+      adj[cursor[graph_edges[j]]++] = i;
+    }
+  }
+  std::vector<unsigned int> degree(array_length);
+  for(int i = 0; i < array_length; i++) degree[i] = (unsigned int)(adj_indices[i+1] - adj_indices[i]);
+
+  // start every component from its lowest degree node
+  std::vector<unsigned int> by_degree(array_length);
+  for(int i = 0; i < array_length; i++) by_degree[i] = i;
+  std::stable_sort(by_degree.begin(), by_degree.end(), degree_less(array_length ? &degree[0] : 0));
+
+  std::vector<unsigned int> order;
+  order.reserve(array_length);
+  std::vector<char> visited(array_length, 0);
+  for(int k = 0; k < array_length; k++)
+  {
+    unsigned int root = by_degree[k];
+    if(visited[root]) continue;
+    visited[root] = 1;
+    size_t head = order.size();
+    order.push_back(root);
+    while(head < order.size())
+    {
+      unsigned int v = order[head++];
+      size_t first = order.size();
+      for(graph_offset_t j = adj_indices[v]; j < adj_indices[v+1]; j++)
+      {
+        if(!visited[adj[j]])
+        {
+          visited[adj[j]] = 1;
+          order.push_back(adj[j]);
+        }
+      }
+      std::stable_sort(order.begin() + first, order.end(), degree_less(&degree[0]));
+    }
+  }
+
+  new_id.resize(array_length);
+  for(int i = 0; i < array_length; i++) new_id[order[i]] = array_length - 1 - i;
+}
+
+// Apply a renumbering to the CSR and the per-node out-link weights. Row
+// new_id[v] of the result is row v of the input with every source mapped
+// through new_id.
+template <typename Offset>
+inline void host_graph_permute(const Offset *graph_indices, const graph_node_t *graph_edges, const float *inv_edges_per_node,
+                               int array_length, const std::vector<unsigned int> &new_id,
+                               Offset *perm_indices, graph_node_t *perm_edges, float *perm_inv_edges_per_node)
+{
+  std::vector<unsigned int> old_id(array_length);
+  for(int i = 0; i < array_length; i++) old_id[new_id[i]] = i;
+
+  perm_indices[0] = 0;
+  for(int r = 0; r < array_length; r++)
+  {
+    unsigned int v = old_id[r];
+    perm_indices[r+1] = perm_indices[r] + graph_indices[v+1] - graph_indices[v];
+    perm_inv_edges_per_node[r] = inv_edges_per_node[v];
+  }
+  #pragma omp parallel for schedule(guided)
+  for(int r = 0; r < array_length; r++)
+  {
+    unsigned int v = old_id[r];
+    Offset out = perm_indices[r];
+    for(Offset j = graph_indices[v]; j < graph_indices[v+1]; j++)
+    {
+      perm_edges[out++] = new_id[graph_edges[j]];
+    }
+  }
+}
+
+// Move a rank vector into the new numbering and back again.
+inline void host_permute_nodes(const float *nodes, float *perm_nodes, const std::vector<unsigned int> &new_id, int array_length)
+{
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < array_length; i++)
+  {
+    perm_nodes[new_id[i]] = nodes[i];
+  }
+}
+
+inline void host_unpermute_nodes(const float *perm_nodes, float *nodes, const std::vector<unsigned int> &new_id, int array_length)
+{
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < array_length; i++)
+  {
+    nodes[i] = perm_nodes[new_id[i]];
+  }
+}
+
+// Contribution-vector propagate. One streaming pass builds
+// contrib[v] = rank[v]*inv_edges_per_node[v], so every edge only does a
+// single random gather instead of two. The row sums are vectorized with
+// hardware gathers when the compiler targets AVX-512 or AVX2, and the
+// damping is applied as part of the store.
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+inline float host_row_sum_gather(const graph_node_t *edges, unsigned int count, const float *contrib)
+{
+#if defined(__AVX512F__)
+  __m512 acc = _mm512_setzero_ps();
+  unsigned int j = 0;
+  for(; j + 16 <= count; j += 16)
+  {
+    __m512i idx = _mm512_loadu_si512((const void *)(edges + j));
+    acc = _mm512_add_ps(acc, _mm512_i32gather_ps(idx, contrib, 4));
+  }
+  if(j < count)
+  {
+    __mmask16 mask = (__mmask16)((1u << (count - j)) - 1);
+    __m512i idx = _mm512_maskz_loadu_epi32(mask, edges + j);
+    acc = _mm512_add_ps(acc, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, idx, contrib, 4));
+  }
+  return _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__)
+  __m256 acc = _mm256_setzero_ps();
+  unsigned int j = 0;
+  for(; j + 8 <= count; j += 8)
+  {
+    __m256i idx = _mm256_loadu_si256((const __m256i *)(edges + j));
+    acc = _mm256_add_ps(acc, _mm256_i32gather_ps(contrib, idx, 4));
+  }
+  if(j < count)
+  {
+    // lanes past the end of the row get a zero mask and aren't loaded
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - j)), lane);
+    __m256i idx  = _mm256_maskload_epi32((const int *)(edges + j), mask);
+    acc = _mm256_add_ps(acc, _mm256_mask_i32gather_ps(_mm256_setzero_ps(), contrib, idx, _mm256_castsi256_ps(mask), 4));
+  }
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+#else
+  float sum = 0.f;
+  for(unsigned int j = 0; j < count; j++)
+  {
+    sum += contrib[edges[j]];
+  }
+  return sum;
+#endif
+}
+
+inline void host_graph_contrib(const float *graph_nodes_in, const float *inv_edges_per_node, float *contrib, int array_length)
+{
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < array_length; i++)
+  {
+    contrib[i] = graph_nodes_in[i]*inv_edges_per_node[i];
+  }
+}
+
+// contrib is scratch space of array_length floats.
+template <typename Offset>
+inline void host_graph_propagate_contrib(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                         const float *graph_nodes_in, float *graph_nodes_out,
+                                         const float *inv_edges_per_node, float *contrib, int array_length)
+{
+  const float teleport = 0.5f/(float)array_length;
+  host_graph_contrib(graph_nodes_in, inv_edges_per_node, contrib, array_length);
+
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    Offset start = graph_indices[i];
+    float sum = host_row_sum_gather(graph_edges + start, (unsigned int)(graph_indices[i+1] - start), contrib);
+    graph_nodes_out[i] = teleport + 0.5f*sum;
+  }
+}
+
+template <typename Offset>
+inline void host_graph_iterate_contrib(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                       float *graph_nodes_A, float *graph_nodes_B,
+                                       const float *inv_edges_per_node, int nr_iterations, int array_length)
+{
+  assert((nr_iterations % 2) == 0);
+  std::vector<float> contrib(array_length);
+  for(int iter = 0; iter < nr_iterations; iter+=2)
+  {
+    host_graph_propagate_contrib(graph_indices, graph_edges, graph_nodes_A, graph_nodes_B, inv_edges_per_node, &contrib[0], array_length);
+    host_graph_propagate_contrib(graph_indices, graph_edges, graph_nodes_B, graph_nodes_A, inv_edges_per_node, &contrib[0], array_length);
+  }
+}
+
+// Compressed adjacency. Every row's sources are sorted, delta encoded and
+// written as byte-aligned varints (7 bits per byte, high bit set on all but
+// the last byte). With sorted lists most deltas fit in one or two bytes
+// instead of four, which cuts the edge stream that dominates the traffic
+// of every sweep; the decode is a few shifts and adds per edge.
+struct compressed_graph
+{
+  std::vector<graph_offset_t> row_offsets; // array_length+1 byte offsets into data
+  std::vector<unsigned char> data;
+};
+
+inline unsigned char *host_varint_encode(unsigned int value, unsigned char *out)
+{
+  while(value >= 0x80)
+  {
+    *out++ = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (unsigned char)value;
+  return out;
+}
+
+inline const unsigned char *host_varint_decode(const unsigned char *in, unsigned int &value)
+{
+  unsigned int v = *in & 0x7f;
+  unsigned int shift = 7;
+  while(*in++ & 0x80)
+  {
+    v |= (unsigned int)(*in & 0x7f) << shift;
+    shift += 7;
+  }
+  value = v;
+  return in;
+}
+
+inline unsigned int host_varint_bytes(unsigned int value)
+{
+  unsigned int bytes = 1;
+  while(value >= 0x80)
+  {
+    value >>= 7;
+    bytes++;
+  }
+  return bytes;
+}
+
+// Two passes over the rows, so no worst-case sized temporary is needed:
+// the first sizes every encoded row, a prefix sum turns the sizes into
+// row_offsets, and the second encodes straight into cg.data. Rows are
+// independent, so both passes run in parallel.
+template <typename Offset>
+inline void host_graph_compress(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                compressed_graph &cg)
+{
+  cg.row_offsets.resize(array_length + 1);
+  cg.row_offsets[0] = 0;
+  #pragma omp parallel
+  {
+    std::vector<unsigned int> row(16);
+    #pragma omp for schedule(guided)
+    for(int i = 0; i < array_length; i++)
+    {
+      row.assign(graph_edges + graph_indices[i], graph_edges + graph_indices[i+1]);
+      std::sort(row.begin(), row.end());
+      graph_offset_t bytes = 0;
+      unsigned int prev = 0;
+      for(size_t k = 0; k < row.size(); k++)
+      {
+        bytes += host_varint_bytes(row[k] - prev);
+        prev = row[k];
+      }
+      cg.row_offsets[i+1] = bytes;
+    }
+  }
+  for(int i = 0; i < array_length; i++) cg.row_offsets[i+1] += cg.row_offsets[i];
+
+  cg.data.resize(cg.row_offsets[array_length]);
+  unsigned char *data = cg.data.empty() ? 0 : &cg.data[0];
+  #pragma omp parallel
+  {
+    std::vector<unsigned int> row(16);
+    #pragma omp for schedule(guided)
+    for(int i = 0; i < array_length; i++)
+    {
+      row.assign(graph_edges + graph_indices[i], graph_edges + graph_indices[i+1]);
+      std::sort(row.begin(), row.end());
+      unsigned char *out = data + cg.row_offsets[i];
+      unsigned int prev = 0;
+      for(size_t k = 0; k < row.size(); k++)
+      {
+        out = host_varint_encode(row[k] - prev, out);
+        prev = row[k];
+      }
+    }
+  }
+}
+
+// Decode on the fly; gathers from the contribution vector like
+// host_graph_propagate_contrib.
+inline void host_graph_propagate_compressed(const compressed_graph &cg, const float *graph_nodes_in, float *graph_nodes_out,
+                                            const float *inv_edges_per_node, float *contrib, int array_length)
+{
+  const float teleport = 0.5f/(float)array_length;
+  const graph_offset_t *row_offsets = &cg.row_offsets[0];
+  const unsigned char *data = cg.data.empty() ? 0 : &cg.data[0];
+  host_graph_contrib(graph_nodes_in, inv_edges_per_node, contrib, array_length);
+
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    const unsigned char *in  = data + row_offsets[i];
+    const unsigned char *end = data + row_offsets[i+1];
+    unsigned int node = 0;
+    float sum = 0.f;
+    while(in < end)
+    {
+      unsigned int delta;
+      in = host_varint_decode(in, delta);
+      node += delta;
+      sum += contrib[node];
+    }
+    graph_nodes_out[i] = teleport + 0.5f*sum;
+  }
+}
+
+inline void host_graph_iterate_compressed(const compressed_graph &cg, float *graph_nodes_A, float *graph_nodes_B,
+                                          const float *inv_edges_per_node, int nr_iterations, int array_length)
+{
+  assert((nr_iterations % 2) == 0);
+  std::vector<float> contrib(array_length);
+  for(int iter = 0; iter < nr_iterations; iter+=2)
+  {
+    host_graph_propagate_compressed(cg, graph_nodes_A, graph_nodes_B, inv_edges_per_node, &contrib[0], array_length);
+    host_graph_propagate_compressed(cg, graph_nodes_B, graph_nodes_A, inv_edges_per_node, &contrib[0], array_length);
+  }
+}
+
+// One sweep like host_graph_propagate_contrib; returns the L1 distance
+// between graph_nodes_in and graph_nodes_out.
+template <typename Offset>
+inline double host_graph_propagate_residual(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                            const float *graph_nodes_in, float *graph_nodes_out,
+                                            const float *inv_edges_per_node, float *contrib, int array_length,
+                                            float damping = 0.5f)
+{
+  const float teleport = (1.f - damping)/(float)array_length;
+  double residual = 0.0;
+  host_graph_contrib(graph_nodes_in, inv_edges_per_node, contrib, array_length);
+
+  #pragma omp parallel for schedule(guided) reduction(+:residual)
+  for(int i = 0; i < array_length; i++)
+  {
+    Offset start = graph_indices[i];
+    float rank = teleport + damping*host_row_sum_gather(graph_edges + start, (unsigned int)(graph_indices[i+1] - start), contrib);
+    residual += fabs(rank - graph_nodes_in[i]);
+    graph_nodes_out[i] = rank;
+  }
+  return residual;
+}
+
+// Convergence-driven iteration. Same sweep as host_graph_propagate_contrib,
+// but the L1 distance between successive iterates is reduced on the fly
+// and the loop stops once it drops below tolerance. Returns the number of
+// sweeps done; the result always ends up in graph_nodes_A.
+template <typename Offset>
+inline int host_graph_iterate_converge(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                       float *graph_nodes_A, float *graph_nodes_B,
+                                       const float *inv_edges_per_node, int max_iterations, double tolerance, int array_length)
+{
+  std::vector<float> contrib(array_length);
+  float *in  = graph_nodes_A;
+  float *out = graph_nodes_B;
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    double residual = host_graph_propagate_residual(graph_indices, graph_edges, in, out, inv_edges_per_node, &contrib[0], array_length);
+    std::swap(in, out);
+    iter++;
+    if(residual < tolerance) break;
+  }
+  if(in != graph_nodes_A)
+  {
+    std::copy(in, in + array_length, graph_nodes_A);
+  }
+  return iter;
+}
+
+// Transposed CSR: for every node the list of nodes it links to. Needed to
+// push updates along out-links.
+template <typename Offset>
+inline void host_graph_transpose(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                 std::vector<Offset> &out_indices, std::vector<graph_node_t> &out_edges)
+{
+  out_indices.assign(array_length + 1, 0);
+  for(Offset j = 0; j < graph_indices[array_length]; j++)
+  {
+    out_indices[graph_edges[j]+1]++;
+  }
+  for(int i = 0; i < array_length; i++) out_indices[i+1] += out_indices[i];
+  std::vector<Offset> cursor(out_indices.begin(), out_indices.end() - 1);
+  out_edges.resize(graph_indices[array_length]);
+  for(int i = 0; i < array_length; i++)
+  {
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      out_edges[cursor[graph_edges[j]]++] = i;
+    }
+  }
+}
+
+// Delta PageRank. With r' = t + 0.5*A*r, the change between iterates obeys
+// delta' = 0.5*A*delta, so after one full sweep only the changes need to be
+// propagated. Nodes whose change is below threshold are dropped from the
+// frontier; the others push their change along their out-links into a
+// sparse accumulator. Later sweeps only touch the active set and the nodes
+// it links to. While the frontier is still a large part of the graph the
+// same update is done as a dense pull over the CSR, which beats scattered
+// atomic pushes. graph_nodes_A holds the start vector on entry and the
+// ranks on exit. Returns the number of sweeps done.
+template <typename Offset>
+inline int host_graph_iterate_delta(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                    const std::vector<Offset> &out_indices, const std::vector<graph_node_t> &out_edges,
+                                    float *graph_nodes_A, float *graph_nodes_B, const float *inv_edges_per_node,
+                                    int max_iterations, float threshold, int array_length)
+{
+  if(max_iterations <= 0) return 0;
+
+  // first sweep is a full pull
+  std::vector<float> delta(array_length);
+  {
+    std::vector<float> contrib(array_length);
+    host_graph_propagate_contrib(graph_indices, graph_edges, graph_nodes_A, graph_nodes_B, inv_edges_per_node, &contrib[0], array_length);
+  }
+  std::vector<unsigned int> frontier;
+  for(int i = 0; i < array_length; i++)
+  {
+    delta[i] = graph_nodes_B[i] - graph_nodes_A[i];
+    graph_nodes_A[i] = graph_nodes_B[i];
+    if(fabs(delta[i]) > threshold) frontier.push_back(i);
+  }
+
+  std::vector<float> delta_next(array_length, 0.f);
+  std::vector<float> contrib(array_length, 0.f);
+  std::vector<char> touched(array_length, 0);
+  std::vector<unsigned int> next;
+  int iter = 1;
+  while(iter < max_iterations && !frontier.empty())
+  {
+    if(frontier.size() > (size_t)array_length / 20)
+    {
+      // dense step: pull the changes of the active nodes
+      std::fill(contrib.begin(), contrib.end(), 0.f);
+      for(size_t k = 0; k < frontier.size(); k++)
+      {
+        contrib[frontier[k]] = delta[frontier[k]]*inv_edges_per_node[frontier[k]];
+      }
+      #pragma omp parallel for schedule(guided)
+      for(int i = 0; i < array_length; i++)
+      {
+        Offset start = graph_indices[i];
+        float d = 0.5f*host_row_sum_gather(graph_edges + start, (unsigned int)(graph_indices[i+1] - start), &contrib[0]);
+        graph_nodes_A[i] += d;
+        delta[i] = d;
+      }
+      frontier.clear();
+      for(int i = 0; i < array_length; i++)
+      {
+        if(fabs(delta[i]) > threshold) frontier.push_back(i);
+      }
+      iter++;
+      continue;
+    }
+
+    next.clear();
+    #pragma omp parallel
+    {
+      std::vector<unsigned int> local_next;
+      #pragma omp for schedule(guided)
+      for(int k = 0; k < (int)frontier.size(); k++)
+      {
+        unsigned int v = frontier[k];
+        float push = 0.5f*delta[v]*inv_edges_per_node[v];
+        for(Offset j = out_indices[v]; j < out_indices[v+1]; j++)
+        {
+          unsigned int u = out_edges[j];
+          char was_touched;
+          #pragma omp atomic update
+          delta_next[u] += push;
+          #pragma omp atomic capture
+          { was_touched = touched[u]; touched[u] = 1; }
+          if(!was_touched) local_next.push_back(u);
+        }
+      }
+      #pragma omp critical
+      next.insert(next.end(), local_next.begin(), local_next.end());
+    }
+
+    // apply the sparse update and build the next frontier
+    frontier.clear();
+    for(size_t k = 0; k < next.size(); k++)
+    {
+      unsigned int u = next[k];
+      graph_nodes_A[u] += delta_next[u];
+      delta[u] = delta_next[u];
+      if(fabs(delta[u]) > threshold) frontier.push_back(u);
+      delta_next[u] = 0.f;
+      touched[u] = 0;
+    }
+    iter++;
+  }
+  return iter;
+}
+
+// Dynamic graph for incremental updates. Each row keeps some slack space
+// after its edges; a row that runs out of room is moved to the end of the
+// item array with twice the capacity. The graph is stored both ways: the
+// in-link rows are used for pull sweeps, the out-link rows to push changes.
+// inv_edges_per_node is kept at 1/out-degree (0 for dangling nodes).
+struct dynamic_rows
+{
+  std::vector<graph_offset_t> start;
+  std::vector<unsigned int> size;
+  std::vector<unsigned int> capacity;
+  std::vector<graph_node_t> items;
+};
+
+struct dynamic_graph
+{
+  int array_length;
+  dynamic_rows in;
+  dynamic_rows out;
+  std::vector<unsigned int> out_degree;
+  std::vector<float> inv_edges_per_node;
+};
+
+struct edge_update
+{
+  unsigned int src;   // page with the link
+  unsigned int dst;   // page linked to
+};
+
+template <typename Offset>
+inline void host_rows_build(const Offset *indices, const graph_node_t *items, int nr_rows, dynamic_rows &rows)
+{
+  rows.start.resize(nr_rows);
+  rows.size.resize(nr_rows);
+  rows.capacity.resize(nr_rows);
+  graph_offset_t total = 0;
+  for(int i = 0; i < nr_rows; i++)
+  {
+    rows.start[i]    = total;
+    rows.size[i]     = (unsigned int)(indices[i+1] - indices[i]);
+    rows.capacity[i] = rows.size[i] + rows.size[i]/4 + 2;
+    total += rows.capacity[i];
+  }
+  rows.items.resize(total);
+  for(int i = 0; i < nr_rows; i++)
+  {
+    std::copy(items + indices[i], items + indices[i+1], rows.items.begin() + rows.start[i]);
+  }
+}
+
+inline void host_rows_insert(dynamic_rows &rows, unsigned int r, unsigned int value)
+{
+  if(rows.size[r] == rows.capacity[r])
+  {
+    graph_offset_t new_start = rows.items.size();
+    rows.capacity[r] *= 2;
+    rows.items.resize(rows.items.size() + rows.capacity[r]);
+    std::copy(rows.items.begin() + rows.start[r], rows.items.begin() + rows.start[r] + rows.size[r], rows.items.begin() + new_start);
+    rows.start[r] = new_start;
+  }
+  rows.items[rows.start[r] + rows.size[r]++] = value;
+}
+
+// Remove one occurrence of value from row r; returns false if it isn't there.
+inline bool host_rows_remove(dynamic_rows &rows, unsigned int r, unsigned int value)
+{
+  unsigned int *row = &rows.items[rows.start[r]];
+  for(unsigned int k = 0; k < rows.size[r]; k++)
+  {
+    if(row[k] == value)
+    {
+      row[k] = row[--rows.size[r]];
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Offset>
+inline void host_dynamic_graph_build(const Offset *graph_indices, const graph_node_t *graph_edges, int array_length,
+                                     dynamic_graph &dg)
+{
+  dg.array_length = array_length;
+  host_rows_build(graph_indices, graph_edges, array_length, dg.in);
+  std::vector<Offset> out_indices;
+  std::vector<graph_node_t> out_edges;
+  host_graph_transpose(graph_indices, graph_edges, array_length, out_indices, out_edges);
+  host_rows_build(&out_indices[0], out_edges.empty() ? 0 : &out_edges[0], array_length, dg.out);
+  dg.out_degree.resize(array_length);
+  dg.inv_edges_per_node.resize(array_length);
+  for(int i = 0; i < array_length; i++)
+  {
+    dg.out_degree[i] = dg.out.size[i];
+    dg.inv_edges_per_node[i] = dg.out_degree[i] ? 1.f/(float)dg.out_degree[i] : 0.f;
+  }
+}
+
+// Full pull sweeps over the dynamic graph until the L1 residual drops below
+// tolerance, like host_graph_iterate_converge. Used for the initial ranks
+// and as the from-scratch baseline.
+inline int host_dynamic_graph_iterate(const dynamic_graph &dg, float *graph_nodes_A, float *graph_nodes_B,
+                                      int max_iterations, double tolerance)
+{
+  const int array_length = dg.array_length;
+  const float teleport = 0.5f/(float)array_length;
+  const graph_node_t *items = dg.in.items.empty() ? 0 : &dg.in.items[0];
+  std::vector<float> contrib(array_length);
+  float *in  = graph_nodes_A;
+  float *out = graph_nodes_B;
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    host_graph_contrib(in, &dg.inv_edges_per_node[0], &contrib[0], array_length);
+    double residual = 0.0;
+    #pragma omp parallel for schedule(guided) reduction(+:residual)
+    for(int i = 0; i < array_length; i++)
+    {
+      float rank = teleport + 0.5f*host_row_sum_gather(items + dg.in.start[i], dg.in.size[i], &contrib[0]);
+      residual += fabs(rank - in[i]);
+      out[i] = rank;
+    }
+    std::swap(in, out);
+    iter++;
+    if(residual < tolerance) break;
+  }
+  if(in != graph_nodes_A)
+  {
+    std::copy(in, in + array_length, graph_nodes_A);
+  }
+  return iter;
+}
+
+// Apply a batch of edge insertions and deletions and bring graph_nodes
+// (the ranks of the graph before the batch) up to date. Only the sources
+// whose links changed have a different contribution, so the first change
+// vector is 0.5*(A_new - A_old)*r and is built from their old and new
+// out-links alone. It is then pushed through the new graph like in
+// host_graph_iterate_delta until every change is below threshold. Deleting
+// an edge that doesn't exist is ignored. Returns the number of push sweeps.
+inline int host_dynamic_graph_update(dynamic_graph &dg, const std::vector<edge_update> &insertions,
+                                     const std::vector<edge_update> &deletions, float *graph_nodes,
+                                     int max_iterations, float threshold)
+{
+  const int array_length = dg.array_length;
+  std::vector<float> delta(array_length, 0.f);
+  std::vector<char> touched(array_length, 0);
+  std::vector<unsigned int> active;
+
+  // changed sources, each listed once
+  std::vector<unsigned int> sources;
+  std::vector<char> is_source(array_length, 0);
+  for(size_t k = 0; k < insertions.size() + deletions.size(); k++)
+  {
+    unsigned int s = k < insertions.size() ? insertions[k].src : deletions[k - insertions.size()].src;
+    if(!is_source[s]) { is_source[s] = 1; sources.push_back(s); }
+  }
+
+  // take out the old contributions of the changed sources
+  for(size_t k = 0; k < sources.size(); k++)
+  {
+    unsigned int s = sources[k];
+    float push = 0.5f*graph_nodes[s]*dg.inv_edges_per_node[s];
+    for(unsigned int j = 0; j < dg.out.size[s]; j++)
+    {
+      unsigned int u = dg.out.items[dg.out.start[s] + j];
+      delta[u] -= push;
+      if(!touched[u]) { touched[u] = 1; active.push_back(u); }
+    }
+  }
+
+  for(size_t k = 0; k < deletions.size(); k++)
+  {
+    if(host_rows_remove(dg.out, deletions[k].src, deletions[k].dst))
+    {
+      host_rows_remove(dg.in, deletions[k].dst, deletions[k].src);
+      dg.out_degree[deletions[k].src]--;
+    }
+  }
+  for(size_t k = 0; k < insertions.size(); k++)
+  {
+    host_rows_insert(dg.out, insertions[k].src, insertions[k].dst);
+    host_rows_insert(dg.in, insertions[k].dst, insertions[k].src);
+    dg.out_degree[insertions[k].src]++;
+  }
+
+  // and add back the new ones
+  for(size_t k = 0; k < sources.size(); k++)
+  {
+    unsigned int s = sources[k];
+    dg.inv_edges_per_node[s] = dg.out_degree[s] ? 1.f/(float)dg.out_degree[s] : 0.f;
+    float push = 0.5f*graph_nodes[s]*dg.inv_edges_per_node[s];
+    for(unsigned int j = 0; j < dg.out.size[s]; j++)
+    {
+      unsigned int u = dg.out.items[dg.out.start[s] + j];
+      delta[u] += push;
+      if(!touched[u]) { touched[u] = 1; active.push_back(u); }
+    }
+  }
+
+  // warm-started delta propagation over the affected region only
+  std::vector<float> delta_next(array_length, 0.f);
+  std::vector<unsigned int> frontier, next;
+  int iter = 0;
+  while(true)
+  {
+    frontier.clear();
+    for(size_t k = 0; k < active.size(); k++)
+    {
+      unsigned int u = active[k];
+      touched[u] = 0;
+      graph_nodes[u] += delta[u];
+      if(fabs(delta[u]) > threshold) frontier.push_back(u);
+      else delta[u] = 0.f;
+    }
+    if(frontier.empty() || iter == max_iterations) break;
+
+    next.clear();
+    for(size_t k = 0; k < frontier.size(); k++)
+    {
+      unsigned int v = frontier[k];
+      float push = 0.5f*delta[v]*dg.inv_edges_per_node[v];
+      delta[v] = 0.f;
+      for(unsigned int j = 0; j < dg.out.size[v]; j++)
+      {
+        unsigned int u = dg.out.items[dg.out.start[v] + j];
+        delta_next[u] += push;
+        if(!touched[u]) { touched[u] = 1; next.push_back(u); }
+      }
+    }
+    for(size_t k = 0; k < next.size(); k++)
+    {
+      delta[next[k]] = delta_next[next[k]];
+      delta_next[next[k]] = 0.f;
+    }
+    active.swap(next);
+    iter++;
+  }
+  return iter;
+}
+
+// Batched personalized PageRank. B rank vectors are propagated together,
+// stored interleaved per node (node v's B values are contiguous), so each
+// edge gathers one B-wide vector instead of one float. The edge stream is
+// then read once for the whole batch. Vector b teleports uniformly to its
+// own seed set: r_b = 0.5*e_{S_b}/|S_b| + 0.5*A*r_b.
+template <int B, typename Offset>
+inline void host_graph_propagate_batched(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                         const float *graph_nodes_in, float *graph_nodes_out,
+                                         const float *inv_edges_per_node, float *contrib,
+                                         const std::vector<std::vector<unsigned int> > &seeds, int array_length)
+{
+  #pragma omp parallel for schedule(static)
+  for(int v = 0; v < array_length; v++)
+  {
+    for(int b = 0; b < B; b++)
+    {
+      contrib[(size_t)v*B + b] = graph_nodes_in[(size_t)v*B + b]*inv_edges_per_node[v];
+    }
+  }
+
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < array_length; i++)
+  {
+    float sum[B];
+    for(int b = 0; b < B; b++) sum[b] = 0.f;
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    {
+      const float *c = contrib + (size_t)graph_edges[j]*B;
+      for(int b = 0; b < B; b++) sum[b] += c[b];
+    }
+    for(int b = 0; b < B; b++) graph_nodes_out[(size_t)i*B + b] = 0.5f*sum[b];
+  }
+
+  // sparse teleport to the seeds
+  for(int b = 0; b < (int)seeds.size(); b++)
+  {
+    if(seeds[b].empty()) continue;
+    float teleport = 0.5f/(float)seeds[b].size();
+    for(size_t k = 0; k < seeds[b].size(); k++)
+    {
+      graph_nodes_out[(size_t)seeds[b][k]*B + b] += teleport;
+    }
+  }
+}
+
+// Run nr_iterations sweeps for one batch of up to B seed sets, starting
+// every vector at its teleport distribution. ranks gets vector b at
+// ranks[b*array_length], for b < seeds.size().
+template <int B, typename Offset>
+inline void host_graph_iterate_batched(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                       const float *inv_edges_per_node, const std::vector<std::vector<unsigned int> > &seeds,
+                                       int nr_iterations, int array_length, float *ranks)
+{
+  assert((int)seeds.size() <= B);
+  std::vector<float> nodes_A((size_t)array_length*B, 0.f);
+  std::vector<float> nodes_B((size_t)array_length*B);
+  std::vector<float> contrib((size_t)array_length*B);
+  for(int b = 0; b < (int)seeds.size(); b++)
+  {
+    for(size_t k = 0; k < seeds[b].size(); k++)
+    {
+      nodes_A[(size_t)seeds[b][k]*B + b] += 1.f/(float)seeds[b].size();
+    }
+  }
+  float *in  = &nodes_A[0];
+  float *out = &nodes_B[0];
+  for(int iter = 0; iter < nr_iterations; iter++)
+  {
+    host_graph_propagate_batched<B>(graph_indices, graph_edges, in, out, inv_edges_per_node, &contrib[0], seeds, array_length);
+    std::swap(in, out);
+  }
+  for(int b = 0; b < (int)seeds.size(); b++)
+  {
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < array_length; i++)
+    {
+      ranks[(size_t)b*array_length + i] = in[(size_t)i*B + b];
+    }
+  }
+}
+
+// Personalized PageRank for any number of seed sets, PPR_BATCH at a time.
+// A batch of 8 fills one AVX register per gathered node.
+#define PPR_BATCH 8
+
+template <typename Offset>
+inline void host_graph_personalized(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                    const float *inv_edges_per_node, const std::vector<std::vector<unsigned int> > &seeds,
+                                    int nr_iterations, int array_length, float *ranks)
+{
+  for(size_t first = 0; first < seeds.size(); first += PPR_BATCH)
+  {
+    size_t last = std::min(first + PPR_BATCH, seeds.size());
+    std::vector<std::vector<unsigned int> > batch(seeds.begin() + first, seeds.begin() + last);
+    host_graph_iterate_batched<PPR_BATCH>(graph_indices, graph_edges, inv_edges_per_node, batch, nr_iterations,
+                                          array_length, ranks + first*(size_t)array_length);
+  }
+}
+
+// In-place iteration. Rows are updated in order and every gather sees the
+// newest value of its source, Gauss-Seidel style, so only one rank vector
+// is needed and fewer sweeps reach the same residual. Both versions stop
+// once the L1 change of a sweep drops below tolerance and return the number
+// of sweeps done.
+template <typename Offset>
+inline int host_graph_iterate_gauss_seidel(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                           float *graph_nodes, const float *inv_edges_per_node,
+                                           int max_iterations, double tolerance, int array_length)
+{
+  const float teleport = 0.5f/(float)array_length;
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    double residual = 0.0;
+    for(int i = 0; i < array_length; i++)
+    {
+      float sum = 0.f;
+      for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+      {
+        sum += graph_nodes[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
+      }
+      float rank = teleport + 0.5f*sum;
+      residual += fabs(rank - graph_nodes[i]);
+      graph_nodes[i] = rank;
+    }
+    iter++;
+    if(residual < tolerance) break;
+  }
+  return iter;
+}
+
+// Multithreaded asynchronous variant: every thread sweeps its own block of
+// rows in place and reads whatever its sources hold at that moment. The
+// accesses are relaxed atomics, so there are no locks and no torn values;
+// blocks owned by other threads are seen somewhere between their old and
+// new values, which still converges for this contraction.
+template <typename Offset>
+inline int host_graph_iterate_async(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                    float *graph_nodes, const float *inv_edges_per_node,
+                                    int max_iterations, double tolerance, int array_length)
+{
+  const float teleport = 0.5f/(float)array_length;
+  int iter = 0;
+  while(iter < max_iterations)
+  {
+    double residual = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:residual)
+    for(int i = 0; i < array_length; i++)
+    {
+      float sum = 0.f;
+      for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
+      {
+        float source;
+        #pragma omp atomic read
+        source = graph_nodes[graph_edges[j]];
+        sum += source*inv_edges_per_node[graph_edges[j]];
+      }
+      float rank = teleport + 0.5f*sum;
+      float old;
+      #pragma omp atomic read
+      old = graph_nodes[i];
+      residual += fabs(rank - old);
+      #pragma omp atomic write
+      graph_nodes[i] = rank;
+    }
+    iter++;
+    if(residual < tolerance) break;
+  }
+  return iter;
+}
+
+// Power iteration with quadratic extrapolation (Kamvar et al., 2003) for
+// any damping factor. Every extrapolate_every sweeps the last four iterates
+// x0..x3 are combined into x* = b0*x1 + b1*x2 + b2*x3, with the weights
+// from a 2x2 least squares fit that cancels the two slowest error
+// components. The iteration is affine (dangling nodes leak rank), so x* is
+// not renormalized. Safeguards: the fit is skipped when it is
+// ill-conditioned, x* is clamped to non-negative values, and if the sweep
+// after an extrapolation has a larger residual than the sweep before it,
+// x3 is restored and the extrapolation period doubled.
+// extrapolate_every = 0 gives plain power iteration. The result ends up in
+// graph_nodes; returns the number of sweeps, with the number of accepted
+// extrapolations in *extrapolations.
+template <typename Offset>
+inline int host_graph_iterate_extrapolated(const Offset *graph_indices, const graph_node_t *graph_edges,
+                                           float *graph_nodes, const float *inv_edges_per_node, float damping,
+                                           int max_iterations, double tolerance, int extrapolate_every,
+                                           int array_length, int *extrapolations)
+{
+  // history[3] is the newest iterate
+  std::vector<std::vector<float> > history(4, std::vector<float>(graph_nodes, graph_nodes + array_length));
+  std::vector<float> next(array_length), contrib(array_length), backup;
+  int iter = 0, since_extrapolation = 0, accepted = 0, filled = 1;
+  double residual_before = 0.0;
+  bool check_extrapolation = false;
+
+  while(iter < max_iterations)
+  {
+    double residual = host_graph_propagate_residual(graph_indices, graph_edges, &history[3][0], &next[0],
+                                                    inv_edges_per_node, &contrib[0], array_length, damping);
+    iter++;
+    if(check_extrapolation)
+    {
+      check_extrapolation = false;
+      if(residual > residual_before)
+      {
+        // made things worse: go back to the plain iterate and back off
+        history[3].swap(backup);
+        extrapolate_every *= 2;
+        accepted--;
+        since_extrapolation = 0;
+        filled = 1;
+        continue;
+      }
+    }
+    std::rotate(history.begin(), history.begin() + 1, history.end());
+    history[3].swap(next);
+    filled = std::min(filled + 1, 4);
+    since_extrapolation++;
+    if(residual < tolerance) break;
+
+    if(extrapolate_every > 0 && filled == 4 && since_extrapolation >= extrapolate_every)
+    {
+      since_extrapolation = 0;
+      const float *x0 = &history[0][0], *x1 = &history[1][0], *x2 = &history[2][0], *x3 = &history[3][0];
+      // normal equations of min |g1*y1 + g2*y2 + y3| with yk = xk - x0
+      double a11 = 0, a12 = 0, a22 = 0, r1 = 0, r2 = 0;
+      #pragma omp parallel for schedule(static) reduction(+:a11,a12,a22,r1,r2)
+      for(int i = 0; i < array_length; i++)
+      {
+        double y1 = x1[i] - x0[i], y2 = x2[i] - x0[i], y3 = x3[i] - x0[i];
+        a11 += y1*y1; a12 += y1*y2; a22 += y2*y2;
+        r1  -= y1*y3; r2  -= y2*y3;
+      }
+      double det = a11*a22 - a12*a12;
+      if(!(fabs(det) > 1e-12*a11*a22) || a11 == 0.0) continue;
+      double g1 = (r1*a22 - r2*a12)/det;
+      double g2 = (a11*r2 - a12*r1)/det;
+      double b0 = g1 + g2 + 1.0, b1 = g2 + 1.0, b2 = 1.0;
+      double total = b0 + b1 + b2;
+      if(fabs(total) < 1e-12) continue;
+
+      backup = history[3];
+      #pragma omp parallel for schedule(static)
+      for(int i = 0; i < array_length; i++)
+      {
+        double x = (b0*x1[i] + b1*x2[i] + b2*x3[i])/total;
+        history[3][i] = x > 0.0 ? (float)x : 0.f;
+      }
+      // older iterates no longer belong to the same sequence
+      filled = 1;
+      residual_before = residual;
+      check_extrapolation = true;
+      accepted++;
+    }
+  }
+  std::copy(history[3].begin(), history[3].end(), graph_nodes);
+  if(extrapolations) *extrapolations = accepted;
+  return iter;
+}
+
+#endif
@@ -30,24 +30,35 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include <assert.h>
 #include <ctime>
 #include <limits>
 #include <iostream>
 #include "mp1-util.h"
+#include "pagerank-cpu.h"
+#include "graph-io.h"
+#include "graph-engine.h"
 
 event_pair timer;
 
 // amount of floating point numbers between answer and computed value 
 // for the answer to be taken correctly. 2's complement magick.
 const int maxUlps = 10;
+
+// relative error allowed for CPU variants that change the summation order
+const double maxRelativeError = 1e-5;
   
-void host_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float * inv_edges_per_node, int array_length)
+// The CSR can come with 32-bit offsets (the original interface) or with
+// 64-bit graph_offset_t offsets for graphs of more than 4G links; the
+// unsigned int versions below forward to templates on the offset type.
+template <typename Offset>
+void host_graph_propagate(const Offset *graph_indices, const graph_node_t *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float * inv_edges_per_node, int array_length)
 {
   for(int i=0; i < array_length; i++)
   {
     float sum = 0.f; 
-    for(int j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
     {
       sum += graph_nodes_in[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
     }
@@ -55,8 +66,14 @@ void host_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edges
   }
 }
 
+void host_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float * inv_edges_per_node, int array_length)
+{
+  host_graph_propagate<unsigned int>(graph_indices, graph_edges, graph_nodes_in, graph_nodes_out, inv_edges_per_node, array_length);
+}
+
 
-void host_graph_iterate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_A, float *graph_nodes_B, float * inv_edges_per_node, int nr_iterations, int array_length)
+template <typename Offset>
+void host_graph_iterate(const Offset *graph_indices, const graph_node_t *graph_edges, float *graph_nodes_A, float *graph_nodes_B, float * inv_edges_per_node, int nr_iterations, int array_length)
 {
   assert((nr_iterations % 2) == 0);
   for(int iter = 0; iter < nr_iterations; iter+=2)
@@ -66,15 +83,21 @@ void host_graph_iterate(unsigned int *graph_indices, unsigned int *graph_edges,
   }
 }
 
+void host_graph_iterate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_A, float *graph_nodes_B, float * inv_edges_per_node, int nr_iterations, int array_length)
+{
+  host_graph_iterate<unsigned int>(graph_indices, graph_edges, graph_nodes_A, graph_nodes_B, inv_edges_per_node, nr_iterations, array_length);
+}
+
 // TODO your kernel code here
-__global__
-void device_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float *inv_edges_per_node, int array_length)
+template <typename Offset>
+__device__
+void device_graph_propagate_row(const Offset *graph_indices, const graph_node_t *graph_edges, const float *graph_nodes_in, float *graph_nodes_out, const float *inv_edges_per_node, int array_length)
 {
   unsigned int i = threadIdx.x + (blockIdx.y * gridDim.x + blockIdx.x) * blockDim.x ;
   if(i < array_length)
   {
     float sum = 0.f; 
-    for(int j = graph_indices[i]; j < graph_indices[i+1]; j++)
+    for(Offset j = graph_indices[i]; j < graph_indices[i+1]; j++)
     {
       sum += graph_nodes_in[graph_edges[j]]*inv_edges_per_node[graph_edges[j]];
     }
@@ -82,9 +105,23 @@ void device_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edg
   }
 }
 
+template <typename Offset>
+__global__
+void device_graph_propagate(const Offset *graph_indices, const graph_node_t *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float *inv_edges_per_node, int array_length)
+{
+  device_graph_propagate_row(graph_indices, graph_edges, graph_nodes_in, graph_nodes_out, inv_edges_per_node, array_length);
+}
+
+__global__
+void device_graph_propagate(unsigned int *graph_indices, unsigned int *graph_edges, float *graph_nodes_in, float *graph_nodes_out, float *inv_edges_per_node, int array_length)
+{
+  device_graph_propagate_row(graph_indices, graph_edges, graph_nodes_in, graph_nodes_out, inv_edges_per_node, array_length);
+}
+
 //all of your gpu memory allocation and copying to gpu memory has to be in this function
-void device_graph_iterate(unsigned int *h_graph_indices,
-                          unsigned int *h_graph_edges,
+template <typename Offset>
+void device_graph_iterate(const Offset *h_graph_indices,
+                          const graph_node_t *h_graph_edges,
                           float *h_graph_nodes_input,
                           float *h_graph_nodes_result,
                           float *h_inv_edges_per_node,
@@ -92,15 +129,17 @@ void device_graph_iterate(unsigned int *h_graph_indices,
                           int num_elements,
                           int avg_edges)
 {
-  unsigned int *d_graph_indices=0;
-  unsigned int *d_graph_edges=0;
+  Offset *d_graph_indices=0;
+  graph_node_t *d_graph_edges=0;
+  // size by the real edge count, num_elements * avg_edges overflows an int
+  size_t nr_edges = h_graph_indices[num_elements];
   float *d_graph_nodes_A=0;
   float *d_graph_nodes_B=0;
   float *d_inv_edges_per_node=0;
 
   //TODO allocate memory
-  cudaMalloc((void**)&d_graph_indices,  (num_elements+1) * sizeof(unsigned int));
-  cudaMalloc((void**)&d_graph_edges,  num_elements * avg_edges * sizeof(unsigned int));
+  cudaMalloc((void**)&d_graph_indices,  (num_elements+1) * sizeof(Offset));
+  cudaMalloc((void**)&d_graph_edges,  nr_edges * sizeof(graph_node_t));
   cudaMalloc((void**)&d_graph_nodes_A, num_elements * sizeof(float));
   cudaMalloc((void**)&d_graph_nodes_B, num_elements * sizeof(float));
   cudaMalloc((void**)&d_inv_edges_per_node, num_elements * sizeof(float));
@@ -111,8 +150,8 @@ void device_graph_iterate(unsigned int *h_graph_indices,
   }
 
   //TODO copy memory to gpu
-  cudaMemcpy(d_graph_indices, &h_graph_indices[0], (num_elements+1) * sizeof(unsigned int), cudaMemcpyHostToDevice);
-  cudaMemcpy(d_graph_edges, &h_graph_edges[0], num_elements * avg_edges * sizeof(unsigned int), cudaMemcpyHostToDevice);
+  cudaMemcpy(d_graph_indices, &h_graph_indices[0], (num_elements+1) * sizeof(Offset), cudaMemcpyHostToDevice);
+  cudaMemcpy(d_graph_edges, &h_graph_edges[0], nr_edges * sizeof(graph_node_t), cudaMemcpyHostToDevice);
   cudaMemcpy(d_inv_edges_per_node, &h_inv_edges_per_node[0], num_elements * sizeof(float), cudaMemcpyHostToDevice);
   cudaMemcpy(d_graph_nodes_A, &h_graph_nodes_input[0], num_elements * sizeof(float), cudaMemcpyHostToDevice);
   start_timer(&timer);
@@ -127,8 +166,8 @@ void device_graph_iterate(unsigned int *h_graph_indices,
   assert((nr_iterations % 2) == 0);
   for(int iter = 0; iter < nr_iterations; iter+=2)
   {
-    device_graph_propagate<<<nblocks, nthreads>>>(d_graph_indices, d_graph_edges, d_graph_nodes_A, d_graph_nodes_B, d_inv_edges_per_node, num_elements);
-    device_graph_propagate<<<nblocks, nthreads>>>(d_graph_indices, d_graph_edges, d_graph_nodes_B, d_graph_nodes_A, d_inv_edges_per_node, num_elements);
+    device_graph_propagate<Offset><<<nblocks, nthreads>>>(d_graph_indices, d_graph_edges, d_graph_nodes_A, d_graph_nodes_B, d_inv_edges_per_node, num_elements);
+    device_graph_propagate<Offset><<<nblocks, nthreads>>>(d_graph_indices, d_graph_edges, d_graph_nodes_B, d_graph_nodes_A, d_inv_edges_per_node, num_elements);
   }
   check_launch("gpu graph propagate");
   stop_timer(&timer,"gpu graph propagate");
@@ -142,37 +181,156 @@ void device_graph_iterate(unsigned int *h_graph_indices,
   cudaFree(d_inv_edges_per_node);
 }
 
+void device_graph_iterate(unsigned int *h_graph_indices,
+                          unsigned int *h_graph_edges,
+                          float *h_graph_nodes_input,
+                          float *h_graph_nodes_result,
+                          float *h_inv_edges_per_node,
+                          int nr_iterations,
+                          int num_elements,
+                          int avg_edges)
+{
+  device_graph_iterate<unsigned int>(h_graph_indices, h_graph_edges, h_graph_nodes_input, h_graph_nodes_result,
+                                     h_inv_edges_per_node, nr_iterations, num_elements, avg_edges);
+}
 
-int main(void)
+// compare a CPU variant against the reference output
+void check_host_result(const char *name, float *result, float *reference, int num_elements)
+{
+  int num_errors = 0;
+  for(int i=0;i<num_elements;i++)
+  {
+    if(!AlmostEqual2sComplement(result[i],reference[i],maxUlps))
+    {
+      num_errors++;
+    }
+  }
+  if(num_errors > 0)
+  {
+    printf("Output of %s version and normal version didn't match! \n", name);
+  }
+  else
+  {
+    printf("Worked! %s and reference output match. \n", name);
+  }
+}
+
+// compare a CPU variant that sums the same terms in a different order
+// (reassociated or partial row sums): rounding then differs by more than a
+// few ulps on rows with many links, so check a relative tolerance instead
+void check_host_result_relative(const char *name, float *result, float *reference, int num_elements, double tolerance)
+{
+  int num_errors = 0;
+  double max_rel = 0.0;
+  for(int i=0;i<num_elements;i++)
+  {
+    double rel = fabs((double)result[i] - reference[i]) / fabs((double)reference[i]);
+    if(!(rel <= tolerance)) num_errors++;
+    if(rel > max_rel) max_rel = rel;
+  }
+  if(num_errors > 0)
+  {
+    printf("Output of %s version and normal version didn't match! %d elements off by more than %.0e\n", name, num_errors, tolerance);
+  }
+  else
+  {
+    printf("Worked! %s and reference output match (max relative difference %.2e). \n", name, max_rel);
+  }
+}
+
+// for variants that don't do exactly the same arithmetic as the reference
+void report_max_difference(const char *name, float *result, float *reference, int num_elements)
+{
+  double max_rel = 0.0;
+  for(int i=0;i<num_elements;i++)
+  {
+    double rel = fabs((double)result[i] - reference[i]) / fabs((double)reference[i]);
+    if(rel > max_rel) max_rel = rel;
+  }
+  printf("%s: max relative difference to reference %.2e\n", name, max_rel);
+}
+
+void report_bandwidth(const char *name, double seconds, double bytes_per_sweep, int iterations)
+{
+  printf("%s took %.2f ms, %.2f GB/s\n", name, seconds * 1000.0, bytes_per_sweep * iterations / seconds / 1e9);
+}
+
+
+int main(int argc, char **argv)
 {
   // create arrays of 2M elements
   int num_elements = 1 << 21;
   int avg_edges = 8;
   int iterations = 20;
+
+  // optionally run on a real graph instead of the generated one:
+  //   pagerank graph.txt   edge list or Matrix Market, also writes graph.txt.bin
+  //   pagerank graph.bin   binary cache from an earlier run, mapped directly
+  const graph_offset_t *file_indices = 0;
+  const graph_node_t *file_edges = 0;
+  std::vector<graph_offset_t> text_indices;
+  std::vector<graph_node_t> text_edges;
+  mapped_graph mapped;
+  mapped.graph_indices = 0;
+  if(argc > 1)
+  {
+    double load_start = omp_get_wtime();
+    if(host_graph_map_binary(argv[1], mapped))
+    {
+      num_elements = mapped.array_length;
+      file_indices = mapped.graph_indices;
+      file_edges   = mapped.graph_edges;
+    }
+    else if(host_graph_load_text(argv[1], num_elements, text_indices, text_edges))
+    {
+      std::string cache = std::string(argv[1]) + ".bin";
+      if(!host_graph_save_binary(cache.c_str(), num_elements, &text_indices[0], text_edges.empty() ? 0 : &text_edges[0]))
+      {
+        printf("couldn't write graph cache %s\n", cache.c_str());
+      }
+      file_indices = &text_indices[0];
+      file_edges   = text_edges.empty() ? 0 : &text_edges[0];
+    }
+    if(file_indices == 0 || num_elements == 0)
+    {
+      printf("couldn't read graph %s\n", argv[1]);
+      exit(1);
+    }
+    // make room for every edge in the num_elements * avg_edges arrays
+    avg_edges = (int)(file_indices[num_elements] / num_elements + 1);
+    printf("loading %d nodes and %llu edges took %.2f ms\n", num_elements, file_indices[num_elements], (omp_get_wtime() - load_start) * 1000.0);
+  }
   
   // pointers to host & device arrays
-  unsigned int *h_graph_indices = 0;
+  graph_offset_t *h_graph_indices = 0;
   float *h_inv_edges_per_node = 0;
-  unsigned int *h_graph_edges = 0;
+  graph_node_t *h_graph_edges = 0;
   float *h_graph_nodes_input = 0;
   float *h_graph_nodes_result = 0;
   float *h_graph_nodes_checker_A = 0;
   float *h_graph_nodes_checker_B = 0;
+  float *h_graph_nodes_omp_A = 0;
+  float *h_graph_nodes_omp_B = 0;
   
   // malloc host array
   // index array has to be n+1 so that the last thread can 
   // still look at its neighbor for a stopping point
-  h_graph_indices         = (unsigned int*)malloc((num_elements+1) * sizeof(unsigned int));
-  h_inv_edges_per_node    = (float*)       malloc((num_elements) * sizeof(float));
-  h_graph_edges           = (unsigned int*)malloc(num_elements * avg_edges * sizeof(unsigned int));
+  // edge counts are 64-bit: num_elements * avg_edges can pass 2^32
+  size_t max_edges = (size_t)num_elements * avg_edges;
+  h_graph_indices         = (graph_offset_t*)malloc((num_elements+1) * sizeof(graph_offset_t));
+  h_inv_edges_per_node    = (float*)         malloc((num_elements) * sizeof(float));
+  h_graph_edges           = (graph_node_t*)  malloc(max_edges * sizeof(graph_node_t));
   h_graph_nodes_input     = (float*)       malloc(num_elements * sizeof(float));
   h_graph_nodes_result    = (float*)       malloc(num_elements * sizeof(float));
   h_graph_nodes_checker_A = (float*)       malloc(num_elements * sizeof(float));
   h_graph_nodes_checker_B = (float*)       malloc(num_elements * sizeof(float));
+  h_graph_nodes_omp_A     = (float*)       malloc(num_elements * sizeof(float));
+  h_graph_nodes_omp_B     = (float*)       malloc(num_elements * sizeof(float));
   
   // if any memory allocation failed, report an error message
   if(h_graph_indices == 0 || h_graph_edges == 0 || h_graph_nodes_input == 0 || h_graph_nodes_result == 0 || 
-	 h_inv_edges_per_node == 0 || h_graph_nodes_checker_A == 0 || h_graph_nodes_checker_B == 0)
+	 h_inv_edges_per_node == 0 || h_graph_nodes_checker_A == 0 || h_graph_nodes_checker_B == 0 ||
+     h_graph_nodes_omp_A == 0 || h_graph_nodes_omp_B == 0)
   {
     printf("couldn't allocate memory\n");
     exit(1);
@@ -183,35 +341,302 @@ int main(void)
   srand(time(NULL));
    
   h_graph_indices[0] = 0;
+  if(file_indices)
+  {
+    std::copy(file_indices, file_indices + num_elements + 1, h_graph_indices);
+    std::copy(file_edges, file_edges + file_indices[num_elements], h_graph_edges);
+    host_graph_inv_out_degree(h_graph_indices, h_graph_edges, num_elements, h_inv_edges_per_node);
+  }
   for(int i=0;i< num_elements;i++)
   {
-    int nr_edges = (i % (2*avg_edges-1) + 1);
-    h_inv_edges_per_node[i] = 1.f/(float)nr_edges;
-    h_graph_indices[i+1] = h_graph_indices[i] + nr_edges;
-    if(h_graph_indices[i+1] >= (num_elements * avg_edges))
-    {
-      printf("more edges than we have space for\n");
-      exit(1);
-    }
-    for(int j=h_graph_indices[i];j<h_graph_indices[i+1];j++)
+    if(file_indices == 0)
     {
-      h_graph_edges[j] = rand() % num_elements;
+      int nr_edges = (i % (2*avg_edges-1) + 1);
+      h_inv_edges_per_node[i] = 1.f/(float)nr_edges;
+      h_graph_indices[i+1] = h_graph_indices[i] + nr_edges;
+      if(h_graph_indices[i+1] >= max_edges)
+      {
+        printf("more edges than we have space for\n");
+        exit(1);
+      }
+      for(graph_offset_t j=h_graph_indices[i];j<h_graph_indices[i+1];j++)
+      {
+        h_graph_edges[j] = rand() % num_elements;
+      }
     }
     
     h_graph_nodes_input[i] =  1.f/(float)num_elements;
     h_graph_nodes_checker_A[i] =  h_graph_nodes_input[i];
+    h_graph_nodes_omp_A[i] =  h_graph_nodes_input[i];
     h_graph_nodes_result[i] = std::numeric_limits<float>::infinity();
   }
   
+  // graphs with fewer than 2^32 links go through the original 32-bit
+  // interface, which halves the index traffic on the GPU; only larger ones
+  // need the 64-bit offsets
+  std::vector<unsigned int> narrow_indices;
+  if(h_graph_indices[num_elements] <= std::numeric_limits<unsigned int>::max())
+  {
+    narrow_indices.assign(h_graph_indices, h_graph_indices + num_elements + 1);
+  }
+
   //do page rank on the GPU
-  device_graph_iterate(h_graph_indices, h_graph_edges, h_graph_nodes_input, h_graph_nodes_result, h_inv_edges_per_node, iterations, num_elements, avg_edges);
+  if(!narrow_indices.empty())
+    device_graph_iterate(&narrow_indices[0], h_graph_edges, h_graph_nodes_input, h_graph_nodes_result, h_inv_edges_per_node, iterations, num_elements, avg_edges);
+  else
+    device_graph_iterate(h_graph_indices, h_graph_edges, h_graph_nodes_input, h_graph_nodes_result, h_inv_edges_per_node, iterations, num_elements, avg_edges);
   
   start_timer(&timer);
   // generate reference output on CPU
-  host_graph_iterate(h_graph_indices, h_graph_edges, h_graph_nodes_checker_A, h_graph_nodes_checker_B, h_inv_edges_per_node, iterations, num_elements);
+  if(!narrow_indices.empty())
+    host_graph_iterate(&narrow_indices[0], h_graph_edges, h_graph_nodes_checker_A, h_graph_nodes_checker_B, h_inv_edges_per_node, iterations, num_elements);
+  else
+    host_graph_iterate(h_graph_indices, h_graph_edges, h_graph_nodes_checker_A, h_graph_nodes_checker_B, h_inv_edges_per_node, iterations, num_elements);
   
   check_launch("host graph propagate");
   stop_timer(&timer,"host graph propagate");
+
+  double bytes_per_sweep = host_graph_bytes_per_sweep(h_graph_indices, num_elements);
+  double cpu_start;
+
+  // multithreaded CPU version, work split by edge count
+  cpu_start = omp_get_wtime();
+  host_graph_iterate_omp(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_graph_nodes_omp_B, h_inv_edges_per_node, iterations, num_elements);
+  double omp_seconds = omp_get_wtime() - cpu_start;
+  report_bandwidth("host omp graph propagate", omp_seconds, bytes_per_sweep, iterations);
+  check_host_result_relative("OpenMP", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements, maxRelativeError);
+
+  // contribution vector plus SIMD gathers, one random gather per edge
+  std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+  cpu_start = omp_get_wtime();
+  host_graph_iterate_contrib(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_graph_nodes_omp_B, h_inv_edges_per_node, iterations, num_elements);
+  report_bandwidth("host simd contrib graph propagate", omp_get_wtime() - cpu_start, bytes_per_sweep, iterations);
+  check_host_result_relative("SIMD contrib", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements, maxRelativeError);
+
+  // delta + varint compressed edges, decoded on the fly
+  {
+    compressed_graph cg;
+    cpu_start = omp_get_wtime();
+    host_graph_compress(h_graph_indices, h_graph_edges, num_elements, cg);
+    printf("compressing edges from %.1f MB to %.1f MB took %.2f ms\n",
+           h_graph_indices[num_elements] * sizeof(graph_node_t) / 1e6, cg.data.size() / 1e6, (omp_get_wtime() - cpu_start) * 1000.0);
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+    cpu_start = omp_get_wtime();
+    host_graph_iterate_compressed(cg, h_graph_nodes_omp_A, h_graph_nodes_omp_B, h_inv_edges_per_node, iterations, num_elements);
+    report_bandwidth("host compressed graph propagate", omp_get_wtime() - cpu_start, bytes_per_sweep, iterations);
+    check_host_result_relative("compressed", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements, maxRelativeError);
+  }
+
+  // stop on the residual instead of after a fixed number of sweeps
+  std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+  cpu_start = omp_get_wtime();
+  int sweeps = host_graph_iterate_converge(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_graph_nodes_omp_B, h_inv_edges_per_node, 100, 1e-6, num_elements);
+  printf("host converged graph propagate took %.2f ms, %d sweeps\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+  report_max_difference("converged", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements);
+
+  // the usual damping of 0.85 converges much slower; quadratic extrapolation
+  // every few sweeps cuts the number of sweeps on skewed graphs
+  {
+    int extrapolations;
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+    cpu_start = omp_get_wtime();
+    int plain_sweeps = host_graph_iterate_extrapolated(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_inv_edges_per_node,
+                                                       0.85f, 1000, 1e-6, 0, num_elements, &extrapolations);
+    double plain_seconds = omp_get_wtime() - cpu_start;
+    printf("host damping 0.85 graph propagate took %.2f ms, %d sweeps\n", plain_seconds * 1000.0, plain_sweeps);
+
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_B);
+    cpu_start = omp_get_wtime();
+    sweeps = host_graph_iterate_extrapolated(h_graph_indices, h_graph_edges, h_graph_nodes_omp_B, h_inv_edges_per_node,
+                                             0.85f, 1000, 1e-6, 10, num_elements, &extrapolations);
+    double extrapolated_seconds = omp_get_wtime() - cpu_start;
+    printf("host extrapolated graph propagate took %.2f ms, %d sweeps (%d extrapolations), saved %d sweeps and %.2f ms\n",
+           extrapolated_seconds * 1000.0, sweeps, extrapolations, plain_sweeps - sweeps, (plain_seconds - extrapolated_seconds) * 1000.0);
+    report_max_difference("extrapolated", h_graph_nodes_omp_B, h_graph_nodes_omp_A, num_elements);
+  }
+
+  // in place: Gauss-Seidel and its asynchronous multithreaded variant
+  std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+  cpu_start = omp_get_wtime();
+  sweeps = host_graph_iterate_gauss_seidel(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_inv_edges_per_node, 100, 1e-6, num_elements);
+  printf("host gauss-seidel graph propagate took %.2f ms, %d sweeps\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+  report_max_difference("gauss-seidel", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements);
+
+  std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+  cpu_start = omp_get_wtime();
+  sweeps = host_graph_iterate_async(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, h_inv_edges_per_node, 100, 1e-6, num_elements);
+  printf("host async graph propagate took %.2f ms, %d sweeps\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+  report_max_difference("async", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements);
+
+  // delta PageRank: only push the changes of nodes that still move
+  {
+    std::vector<graph_offset_t> out_indices;
+    std::vector<graph_node_t> out_edges;
+    host_graph_transpose(h_graph_indices, h_graph_edges, num_elements, out_indices, out_edges);
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+    cpu_start = omp_get_wtime();
+    sweeps = host_graph_iterate_delta(h_graph_indices, h_graph_edges, out_indices, out_edges, h_graph_nodes_omp_A, h_graph_nodes_omp_B,
+                                      h_inv_edges_per_node, 100, 1e-4f/(float)num_elements, num_elements);
+    printf("host delta graph propagate took %.2f ms, %d sweeps\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+    report_max_difference("delta", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements);
+  }
+
+  // incremental maintenance: apply a batch of link changes to a dynamic
+  // graph and update the ranks from the previous ones
+  {
+    dynamic_graph dg;
+    host_dynamic_graph_build(h_graph_indices, h_graph_edges, num_elements, dg);
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+    host_dynamic_graph_iterate(dg, h_graph_nodes_omp_A, h_graph_nodes_omp_B, 100, 1e-6);
+
+    std::vector<edge_update> insertions, deletions;
+    for(int k = 0; k < 1000; k++)
+    {
+      edge_update e;
+      e.src = rand() % num_elements;
+      e.dst = rand() % num_elements;
+      insertions.push_back(e);
+      e.src = rand() % num_elements;
+      if(dg.out.size[e.src] > 0)
+      {
+        e.dst = dg.out.items[dg.out.start[e.src] + rand() % dg.out.size[e.src]];
+        deletions.push_back(e);
+      }
+    }
+    cpu_start = omp_get_wtime();
+    sweeps = host_dynamic_graph_update(dg, insertions, deletions, h_graph_nodes_omp_A, 100, 1e-4f/(float)num_elements);
+    printf("host incremental update of %d links took %.2f ms, %d sweeps\n", (int)(insertions.size() + deletions.size()),
+           (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+
+    std::vector<float> full_A(h_graph_nodes_input, h_graph_nodes_input + num_elements);
+    cpu_start = omp_get_wtime();
+    sweeps = host_dynamic_graph_iterate(dg, &full_A[0], h_graph_nodes_omp_B, 100, 1e-6);
+    printf("host full recompute took %.2f ms, %d sweeps\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps);
+    report_max_difference("incremental", h_graph_nodes_omp_A, &full_A[0], num_elements);
+  }
+
+  // personalized PageRank for a set of seed sets, batched against one at a time
+  {
+    const int nr_vectors = 16;
+    std::vector<std::vector<unsigned int> > seeds(nr_vectors);
+    for(int b = 0; b < nr_vectors; b++)
+    {
+      for(int k = 0; k < 10; k++) seeds[b].push_back(rand() % num_elements);
+    }
+    std::vector<float> batched_ranks((size_t)nr_vectors * num_elements);
+    std::vector<float> single_ranks((size_t)nr_vectors * num_elements);
+
+    cpu_start = omp_get_wtime();
+    host_graph_personalized(h_graph_indices, h_graph_edges, h_inv_edges_per_node, seeds, iterations, num_elements, &batched_ranks[0]);
+    printf("host batched personalized graph propagate (%d vectors) took %.2f ms\n", nr_vectors, (omp_get_wtime() - cpu_start) * 1000.0);
+
+    cpu_start = omp_get_wtime();
+    for(int b = 0; b < nr_vectors; b++)
+    {
+      std::vector<std::vector<unsigned int> > one(1, seeds[b]);
+      host_graph_iterate_batched<1>(h_graph_indices, h_graph_edges, h_inv_edges_per_node, one, iterations, num_elements, &single_ranks[(size_t)b * num_elements]);
+    }
+    printf("host one-at-a-time personalized graph propagate (%d vectors) took %.2f ms\n", nr_vectors, (omp_get_wtime() - cpu_start) * 1000.0);
+    check_host_result("batched personalized", &batched_ranks[0], &single_ranks[0], nr_vectors * num_elements);
+  }
+
+  // cache-segmented version: one pass per LLC-sized slice of the input
+  segmented_graph seg;
+  cpu_start = omp_get_wtime();
+  host_graph_segment(h_graph_indices, h_graph_edges, num_elements, host_graph_default_segment_size(), seg);
+  printf("segmenting into %d slices of %u nodes took %.2f ms\n", seg.nr_segments, seg.segment_size, (omp_get_wtime() - cpu_start) * 1000.0);
+  std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+  cpu_start = omp_get_wtime();
+  host_graph_iterate_segmented(seg, h_graph_nodes_omp_A, h_graph_nodes_omp_B, h_inv_edges_per_node, iterations, num_elements);
+  report_bandwidth("host segmented graph propagate", omp_get_wtime() - cpu_start, bytes_per_sweep, iterations);
+  check_host_result_relative("segmented", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements, maxRelativeError);
+
+  // reordered versions: renumber the nodes for locality, run on the
+  // permuted graph and map the ranks back to the original ids
+  {
+    std::vector<graph_offset_t> perm_indices(num_elements + 1);
+    std::vector<graph_node_t> perm_edges(h_graph_indices[num_elements]);
+    std::vector<float> perm_inv_edges_per_node(num_elements);
+    std::vector<float> perm_nodes_A(num_elements);
+    std::vector<float> perm_nodes_B(num_elements);
+    std::vector<unsigned int> new_id;
+    const char *order_names[2] = {"degree sorted", "RCM"};
+
+    for(int order = 0; order < 2; order++)
+    {
+      cpu_start = omp_get_wtime();
+      if(order == 0)
+        host_graph_order_degree(h_graph_indices, h_graph_edges, num_elements, new_id);
+      else
+        host_graph_order_rcm(h_graph_indices, h_graph_edges, num_elements, new_id);
+      host_graph_permute(h_graph_indices, h_graph_edges, h_inv_edges_per_node, num_elements, new_id,
+                         &perm_indices[0], &perm_edges[0], &perm_inv_edges_per_node[0]);
+      host_permute_nodes(h_graph_nodes_input, &perm_nodes_A[0], new_id, num_elements);
+      double reorder_seconds = omp_get_wtime() - cpu_start;
+
+      cpu_start = omp_get_wtime();
+      host_graph_iterate_omp(&perm_indices[0], &perm_edges[0], &perm_nodes_A[0], &perm_nodes_B[0], &perm_inv_edges_per_node[0], iterations, num_elements);
+      double perm_seconds = omp_get_wtime() - cpu_start;
+      host_unpermute_nodes(&perm_nodes_A[0], h_graph_nodes_omp_A, new_id, num_elements);
+
+      char name[64];
+      sprintf(name, "host omp %s graph propagate", order_names[order]);
+      report_bandwidth(name, perm_seconds, bytes_per_sweep, iterations);
+      // reordering pays off once the per-sweep saving has covered its cost
+      double saved_per_sweep = (omp_seconds - perm_seconds) / iterations;
+      if(saved_per_sweep > 0)
+        printf("  reordering took %.2f ms, pays off after %.0f sweeps\n", reorder_seconds * 1000.0, reorder_seconds / saved_per_sweep);
+      else
+        printf("  reordering took %.2f ms, never pays off on this graph\n", reorder_seconds * 1000.0);
+      check_host_result(order_names[order], h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements);
+    }
+  }
+
+  // other vertex programs on the same gather-apply traversal
+  {
+    std::copy(h_graph_nodes_input, h_graph_nodes_input + num_elements, h_graph_nodes_omp_A);
+    cpu_start = omp_get_wtime();
+    host_graph_run_program(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A,
+                           pagerank_program(h_inv_edges_per_node, 0.5f, num_elements), iterations, -1.0, num_elements);
+    report_bandwidth("host engine graph propagate", omp_get_wtime() - cpu_start, bytes_per_sweep, iterations);
+    check_host_result_relative("engine", h_graph_nodes_omp_A, h_graph_nodes_checker_A, num_elements, maxRelativeError);
+
+    std::vector<graph_offset_t> sym_indices;
+    std::vector<graph_node_t> sym_edges;
+    host_graph_symmetrize(h_graph_indices, h_graph_edges, num_elements, sym_indices, sym_edges);
+    std::vector<unsigned int> labels(num_elements);
+    for(int i = 0; i < num_elements; i++) labels[i] = i;
+    cpu_start = omp_get_wtime();
+    sweeps = host_graph_run_program(&sym_indices[0], &sym_edges[0], &labels[0], components_program(), num_elements, 0.0, num_elements);
+    int nr_components = 0;
+    for(int i = 0; i < num_elements; i++) if(labels[i] == (unsigned int)i) nr_components++;
+    printf("host connected components took %.2f ms, %d sweeps, %d components\n",
+           (omp_get_wtime() - cpu_start) * 1000.0, sweeps, nr_components);
+
+    std::fill(h_graph_nodes_omp_A, h_graph_nodes_omp_A + num_elements, std::numeric_limits<float>::infinity());
+    h_graph_nodes_omp_A[0] = 0.f;
+    cpu_start = omp_get_wtime();
+    sweeps = host_graph_run_program(h_graph_indices, h_graph_edges, h_graph_nodes_omp_A, sssp_program(), num_elements, 0.0, num_elements);
+    int reached = 0;
+    float max_hops = 0.f;
+    for(int i = 0; i < num_elements; i++)
+    {
+      if(h_graph_nodes_omp_A[i] == std::numeric_limits<float>::infinity()) continue;
+      reached++;
+      max_hops = std::max(max_hops, h_graph_nodes_omp_A[i]);
+    }
+    printf("host shortest paths from node 0 took %.2f ms, %d sweeps, %d nodes reached, at most %.0f hops\n",
+           (omp_get_wtime() - cpu_start) * 1000.0, sweeps, reached, max_hops);
+
+    std::vector<graph_offset_t> out_indices;
+    std::vector<graph_node_t> out_edges;
+    host_graph_transpose(h_graph_indices, h_graph_edges, num_elements, out_indices, out_edges);
+    cpu_start = omp_get_wtime();
+    sweeps = host_graph_hits(h_graph_indices, h_graph_edges, out_indices, out_edges,
+                             h_graph_nodes_omp_A, h_graph_nodes_omp_B, 20, 1e-4, num_elements);
+    int top = (int)(std::max_element(h_graph_nodes_omp_B, h_graph_nodes_omp_B + num_elements) - h_graph_nodes_omp_B);
+    printf("host HITS took %.2f ms, %d rounds, top authority node %d\n", (omp_get_wtime() - cpu_start) * 1000.0, sweeps, top);
+  }
   
   // check CUDA output versus reference output
   int num_errors = 0;
@@ -246,5 +671,8 @@ int main(void)
   free(h_graph_nodes_result);
   free(h_graph_nodes_checker_A);
   free(h_graph_nodes_checker_B);
+  free(h_graph_nodes_omp_A);
+  free(h_graph_nodes_omp_B);
+  if(mapped.graph_indices) host_graph_unmap_binary(mapped);
 }
 
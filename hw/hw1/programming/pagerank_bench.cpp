@@ -0,0 +1,151 @@
+/* PageRank CPU bandwidth benchmark
+ *
+ * Generates graphs in parallel with the counter-based generators of
+ * graph-gen.h and times single propagate sweeps of the multithreaded CPU
+ * kernels over every combination of generator, node count, avg_edges and
+ * thread count. Output is one CSV row per combination and kernel, with the
+ * median and best sweep:
+ *
+ *   generator,nodes,avg_edges,edges,threads,kernel,sweeps,
+ *   median_ms,best_ms,median_gb_s,best_gb_s,median_medges_s,best_medges_s
+ *
+ * GB/s uses the traffic of a plain CSR sweep (host_graph_bytes_per_sweep)
+ * for every kernel, so it is an effective rate that can be compared across
+ * kernels. Progress goes to stderr, so stdout can be redirected to a file.
+ *
+ * usage: ./pagerank_bench [-g uniform,rmat] [-n nodes,...] [-e avg_edges,...]
+ *                         [-t threads,...] [-i sweeps] [-s seed]
+ *   defaults: -g uniform -n 2097152 -e 2,3,...,20 -t <all cores> -i 20
+ *   R-MAT graphs round the node count up to a power of two.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "omp.h"
+#include "bench-util.h"
+#include "graph-types.h"
+#include "graph-gen.h"
+#include "pagerank-cpu.h"
+
+void print_row(const char *generator, int nodes, int avg_edges, graph_offset_t edges, int threads,
+               const char *kernel, sweep_times &t, double bytes_per_sweep)
+{
+  double median = t.median(), best = t.best();
+  printf("%s,%d,%d,%llu,%d,%s,%d,%.3f,%.3f,%.2f,%.2f,%.1f,%.1f\n", generator, nodes, avg_edges, edges, threads, kernel,
+         (int)t.seconds.size(), median * 1000.0, best * 1000.0,
+         bytes_per_sweep / median / 1e9, bytes_per_sweep / best / 1e9, edges / median / 1e6, edges / best / 1e6);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> generators(1, "uniform");
+  std::vector<long long> node_counts(1, 1 << 21);
+  std::vector<long long> edge_counts;
+  for(int e = 2; e <= 20; e++) edge_counts.push_back(e);
+  std::vector<long long> thread_counts(1, omp_get_max_threads());
+  int sweeps = 20;
+  unsigned long long seed = 1;
+
+  int opt;
+  while((opt = getopt(argc, argv, "g:n:e:t:i:s:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'g': generators    = parse_names(optarg); break;
+      case 'n': node_counts   = parse_list(optarg); break;
+      case 'e': edge_counts   = parse_list(optarg); break;
+      case 't': thread_counts = parse_list(optarg); break;
+      case 'i': sweeps = atoi(optarg); break;
+      case 's': seed = strtoull(optarg, 0, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-g uniform,rmat] [-n nodes,...] [-e avg_edges,...] [-t threads,...] [-i sweeps] [-s seed]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(sweeps < 1 || node_counts.empty() || edge_counts.empty() || thread_counts.empty())
+  {
+    fprintf(stderr, "nothing to run\n");
+    return 1;
+  }
+  for(size_t g = 0; g < generators.size(); g++)
+  {
+    if(generators[g] != "uniform" && generators[g] != "rmat")
+    {
+      fprintf(stderr, "unknown generator %s\n", generators[g].c_str());
+      return 1;
+    }
+  }
+
+  printf("generator,nodes,avg_edges,edges,threads,kernel,sweeps,median_ms,best_ms,median_gb_s,best_gb_s,median_medges_s,best_medges_s\n");
+  int max_threads = omp_get_max_threads();
+  for(size_t g = 0; g < generators.size(); g++)
+  {
+    for(size_t n = 0; n < node_counts.size(); n++)
+    {
+      for(size_t e = 0; e < edge_counts.size(); e++)
+      {
+        std::vector<graph_offset_t> graph_indices;
+        std::vector<graph_node_t> graph_edges;
+        std::vector<float> inv_edges_per_node;
+        int avg_edges = (int)edge_counts[e];
+        int nodes = (int)node_counts[n];
+        omp_set_num_threads(max_threads);
+        double gen_start = omp_get_wtime();
+        if(generators[g] == "rmat")
+        {
+          int scale = 0;
+          while((1LL << scale) < nodes) scale++;
+          host_graph_generate_rmat(scale, avg_edges, seed, graph_indices, graph_edges, inv_edges_per_node);
+          nodes = 1 << scale;
+        }
+        else
+        {
+          host_graph_generate_uniform(nodes, avg_edges, seed, graph_indices, graph_edges, inv_edges_per_node);
+        }
+        graph_offset_t nr_edges = graph_indices[nodes];
+        fprintf(stderr, "%s graph with %d nodes and %llu edges took %.2f ms to generate\n",
+                generators[g].c_str(), nodes, nr_edges, (omp_get_wtime() - gen_start) * 1000.0);
+        double bytes_per_sweep = host_graph_bytes_per_sweep(&graph_indices[0], nodes);
+
+        std::vector<float> nodes_A(nodes, 1.f/(float)nodes), nodes_B(nodes), contrib(nodes);
+        for(size_t t = 0; t < thread_counts.size(); t++)
+        {
+          int threads = (int)thread_counts[t];
+          omp_set_num_threads(threads);
+          std::vector<graph_partition> parts;
+          host_graph_partition(&graph_indices[0], nodes, threads, parts);
+
+          // one untimed sweep per kernel to fault in the pages
+          sweep_times omp_times, contrib_times;
+          host_graph_propagate_omp(&graph_indices[0], &graph_edges[0], &nodes_A[0], &nodes_B[0], &inv_edges_per_node[0], nodes, parts);
+          for(int s = 0; s < sweeps; s++)
+          {
+            double start = omp_get_wtime();
+            host_graph_propagate_omp(&graph_indices[0], &graph_edges[0], &nodes_A[0], &nodes_B[0], &inv_edges_per_node[0], nodes, parts);
+            omp_times.seconds.push_back(omp_get_wtime() - start);
+            nodes_A.swap(nodes_B);
+          }
+          print_row(generators[g].c_str(), nodes, avg_edges, nr_edges, threads, "omp", omp_times, bytes_per_sweep);
+
+          host_graph_propagate_contrib(&graph_indices[0], &graph_edges[0], &nodes_A[0], &nodes_B[0], &inv_edges_per_node[0], &contrib[0], nodes);
+          for(int s = 0; s < sweeps; s++)
+          {
+            double start = omp_get_wtime();
+            host_graph_propagate_contrib(&graph_indices[0], &graph_edges[0], &nodes_A[0], &nodes_B[0], &inv_edges_per_node[0], &contrib[0], nodes);
+            contrib_times.seconds.push_back(omp_get_wtime() - start);
+            nodes_A.swap(nodes_B);
+          }
+          print_row(generators[g].c_str(), nodes, avg_edges, nr_edges, threads, "contrib", contrib_times, bytes_per_sweep);
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,395 @@
+/* Distributed PageRank with MPI
+ *
+ * The CSR is cut into contiguous blocks of destination rows, one per MPI
+ * rank, either with the same number of rows per rank or with the same
+ * number of edges per rank (edge-balanced 1D partition). Every rank only
+ * holds its own rows. Before iterating, the ranks build a sparse
+ * communication plan: every rank works out which remote rank values its
+ * edges read (its ghost nodes), asks their owners for them once, and from
+ * then on every sweep only exchanges those boundary values, with
+ * non-blocking point-to-point messages between ranks that actually share
+ * edges.
+ *
+ * The graph is either generated with a counter-based RNG, so that the same
+ * graph comes out for any number of ranks, or taken from a binary CSR cache
+ * written by pagerank (see graph-io.h); each rank maps the file and only
+ * touches its own slice.
+ *
+ * usage: mpirun -np P ./pagerank_mpi nodes_per_rank avg_edges balanced [graph.bin]
+ *   nodes_per_rank - generated graph size scales with P (weak scaling)
+ *   balanced       - 0 for equal rows per rank, 1 for equal edges per rank
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "mpi.h"
+#include "graph-io.h"
+#include "graph-gen.h"
+
+#define MPI_SAFE_CALL( call ) do {                               \
+    int err = call;                                              \
+    if (err != MPI_SUCCESS) {                                    \
+        fprintf(stderr, "MPI error %d in file '%s' at line %i",  \
+               err, __FILE__, __LINE__);                         \
+        exit(1);                                                 \
+    } } while(0)
+
+const int iterations = 20;
+
+// Either the uniform graph of graph-gen.h (node i has i % (2*avg_edges-1) + 1
+// in-links; the source of edge j only depends on j, not on which rank
+// generates it) or a mapped CSR file. Only the rows asked for are ever
+// touched.
+struct global_graph
+{
+  long long nr_nodes;
+  int avg_edges;
+  const graph_offset_t *file_indices;   // 0 for the generated graph
+  const graph_node_t *file_edges;
+
+  unsigned long long edges_before(long long i) const
+  {
+    if(file_indices) return file_indices[i];
+    return host_uniform_edges_before(i, avg_edges);
+  }
+  unsigned int source(unsigned long long j) const
+  {
+    if(file_indices) return file_edges[j];
+    return (unsigned int)(host_random(0, j) % (unsigned long long)nr_nodes);
+  }
+};
+
+// Split the rows into nr_ranks contiguous blocks, by row count or by edge
+// count; the edge split is a binary search over the row offsets.
+void partition_rows(const global_graph &g, int nr_ranks, bool balanced, std::vector<long long> &row_split)
+{
+  row_split.resize(nr_ranks + 1);
+  unsigned long long nr_edges = g.edges_before(g.nr_nodes);
+  for(int r = 0; r <= nr_ranks; r++)
+  {
+    if(!balanced)
+    {
+      row_split[r] = g.nr_nodes * r / nr_ranks;
+      continue;
+    }
+    unsigned long long target = (unsigned long long)((double)nr_edges * r / nr_ranks);
+    long long lo = 0, hi = g.nr_nodes;
+    while(lo < hi)
+    {
+      long long mid = (lo + hi) / 2;
+      if(g.edges_before(mid) < target) lo = mid + 1; else hi = mid;
+    }
+    row_split[r] = lo;
+  }
+  row_split[nr_ranks] = g.nr_nodes;
+}
+
+// One rank's share of the graph plus the communication plan. Edges are
+// renumbered so that local sources index [0, nr_local) and ghost sources
+// index [nr_local, nr_local + nr_ghosts) of the same gather array.
+struct local_graph
+{
+  long long row_begin;
+  int nr_local;
+  std::vector<graph_offset_t> indices;
+  std::vector<graph_node_t> edges;
+  std::vector<float> inv_edges_per_node;
+
+  std::vector<unsigned int> ghosts;          // global ids, sorted, grouped by owner
+  std::vector<int> recv_counts, recv_displs; // per rank, into the ghost part
+  std::vector<unsigned int> send_ids;        // local ids other ranks asked for
+  std::vector<int> send_counts, send_displs;
+};
+
+int owner_of(const std::vector<long long> &row_split, unsigned int v)
+{
+  return (int)(std::upper_bound(row_split.begin(), row_split.end(), (long long)v) - row_split.begin()) - 1;
+}
+
+void exclusive_scan(const std::vector<int> &counts, std::vector<int> &displs)
+{
+  displs.resize(counts.size());
+  int sum = 0;
+  for(size_t k = 0; k < counts.size(); k++) { displs[k] = sum; sum += counts[k]; }
+}
+
+// Send counts[p] values of type T from send at send_displs[p] to every rank
+// p with a nonzero count, and receive into recv. Only ranks that share
+// edges exchange messages.
+template <typename T>
+void sparse_exchange(const T *send, const std::vector<int> &send_counts, const std::vector<int> &send_displs,
+                     T *recv, const std::vector<int> &recv_counts, const std::vector<int> &recv_displs,
+                     MPI_Datatype type, int tag)
+{
+  std::vector<MPI_Request> requests;
+  for(size_t p = 0; p < recv_counts.size(); p++)
+  {
+    if(recv_counts[p] == 0) continue;
+    requests.push_back(MPI_Request());
+    MPI_SAFE_CALL( MPI_Irecv((void *)(recv + recv_displs[p]), recv_counts[p], type, (int)p, tag, MPI_COMM_WORLD, &requests.back()) );
+  }
+  for(size_t p = 0; p < send_counts.size(); p++)
+  {
+    if(send_counts[p] == 0) continue;
+    requests.push_back(MPI_Request());
+    MPI_SAFE_CALL( MPI_Isend((void *)(send + send_displs[p]), send_counts[p], type, (int)p, tag, MPI_COMM_WORLD, &requests.back()) );
+  }
+  if(!requests.empty())
+  {
+    MPI_SAFE_CALL( MPI_Waitall((int)requests.size(), &requests[0], MPI_STATUSES_IGNORE) );
+  }
+}
+
+void build_local_graph(const global_graph &g, const std::vector<long long> &row_split, int rank, local_graph &lg)
+{
+  int nr_ranks = (int)row_split.size() - 1;
+  lg.row_begin = row_split[rank];
+  lg.nr_local  = (int)(row_split[rank+1] - row_split[rank]);
+  unsigned long long first_edge = g.edges_before(lg.row_begin);
+  unsigned long long nr_edges   = g.edges_before(row_split[rank+1]) - first_edge;
+
+  lg.indices.resize(lg.nr_local + 1);
+  lg.edges.resize(nr_edges);
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < lg.nr_local; i++)
+  {
+    unsigned long long begin = g.edges_before(lg.row_begin + i);
+    unsigned long long end   = g.edges_before(lg.row_begin + i + 1);
+    lg.indices[i] = begin - first_edge;
+    for(unsigned long long j = begin; j < end; j++)
+    {
+      lg.edges[j - first_edge] = g.source(j);
+    }
+  }
+  lg.indices[lg.nr_local] = nr_edges;
+
+  // ghost nodes, sorted by id so they come out grouped by owner
+  for(size_t j = 0; j < lg.edges.size(); j++)
+  {
+    long long v = lg.edges[j];
+    if(v < lg.row_begin || v >= lg.row_begin + lg.nr_local) lg.ghosts.push_back(lg.edges[j]);
+  }
+  std::sort(lg.ghosts.begin(), lg.ghosts.end());
+  lg.ghosts.erase(std::unique(lg.ghosts.begin(), lg.ghosts.end()), lg.ghosts.end());
+
+  lg.recv_counts.assign(nr_ranks, 0);
+  for(size_t k = 0; k < lg.ghosts.size(); k++) lg.recv_counts[owner_of(row_split, lg.ghosts[k])]++;
+  exclusive_scan(lg.recv_counts, lg.recv_displs);
+
+  // renumber the edges into the local gather array
+  #pragma omp parallel for schedule(static)
+  for(long long j = 0; j < (long long)lg.edges.size(); j++)
+  {
+    long long v = lg.edges[j];
+    if(v >= lg.row_begin && v < lg.row_begin + lg.nr_local)
+      lg.edges[j] = (unsigned int)(v - lg.row_begin);
+    else
+      lg.edges[j] = lg.nr_local + (unsigned int)(std::lower_bound(lg.ghosts.begin(), lg.ghosts.end(), (unsigned int)v) - lg.ghosts.begin());
+  }
+
+  // tell every owner which of its nodes we need
+  lg.send_counts.assign(nr_ranks, 0);
+  MPI_SAFE_CALL( MPI_Alltoall(&lg.recv_counts[0], 1, MPI_INT, &lg.send_counts[0], 1, MPI_INT, MPI_COMM_WORLD) );
+  exclusive_scan(lg.send_counts, lg.send_displs);
+  lg.send_ids.resize(lg.send_displs[nr_ranks-1] + lg.send_counts[nr_ranks-1]);
+  sparse_exchange(lg.ghosts.empty() ? 0 : &lg.ghosts[0], lg.recv_counts, lg.recv_displs,
+                  lg.send_ids.empty() ? 0 : &lg.send_ids[0], lg.send_counts, lg.send_displs, MPI_UNSIGNED, 0);
+  for(size_t k = 0; k < lg.send_ids.size(); k++) lg.send_ids[k] -= (unsigned int)lg.row_begin;
+
+  // per-node weights
+  lg.inv_edges_per_node.resize(lg.nr_local);
+  if(g.file_indices == 0)
+  {
+    // generated graph: the same 1/in-links weight as pagerank.cu
+    for(int i = 0; i < lg.nr_local; i++)
+    {
+      lg.inv_edges_per_node[i] = 1.f/(float)(lg.indices[i+1] - lg.indices[i]);
+    }
+  }
+  else
+  {
+    // loaded graph: 1/out-degree, with the counts for ghost nodes sent back
+    // to their owners along the plan in reverse
+    std::vector<unsigned int> out_degree(lg.nr_local + lg.ghosts.size(), 0);
+    for(size_t j = 0; j < lg.edges.size(); j++) out_degree[lg.edges[j]]++;
+    std::vector<unsigned int> remote(lg.send_ids.size());
+    sparse_exchange(out_degree.empty() ? 0 : &out_degree[0] + lg.nr_local, lg.recv_counts, lg.recv_displs,
+                    remote.empty() ? 0 : &remote[0], lg.send_counts, lg.send_displs, MPI_UNSIGNED, 1);
+    for(size_t k = 0; k < remote.size(); k++) out_degree[lg.send_ids[k]] += remote[k];
+    for(int i = 0; i < lg.nr_local; i++)
+    {
+      lg.inv_edges_per_node[i] = out_degree[i] ? 1.f/(float)out_degree[i] : 0.f;
+    }
+  }
+}
+
+// One sweep: local contributions, boundary exchange, local row sums.
+void distributed_propagate(const local_graph &lg, long long nr_nodes, const float *nodes_in, float *nodes_out,
+                           std::vector<float> &values, std::vector<float> &send_buffer)
+{
+  const float teleport = 0.5f/(float)nr_nodes;
+  #pragma omp parallel for schedule(static)
+  for(int i = 0; i < lg.nr_local; i++)
+  {
+    values[i] = nodes_in[i]*lg.inv_edges_per_node[i];
+  }
+  for(size_t k = 0; k < lg.send_ids.size(); k++) send_buffer[k] = values[lg.send_ids[k]];
+  sparse_exchange(send_buffer.empty() ? 0 : &send_buffer[0], lg.send_counts, lg.send_displs,
+                  values.empty() ? 0 : &values[0] + lg.nr_local, lg.recv_counts, lg.recv_displs, MPI_FLOAT, 2);
+
+  #pragma omp parallel for schedule(guided)
+  for(int i = 0; i < lg.nr_local; i++)
+  {
+    float sum = 0.f;
+    for(graph_offset_t j = lg.indices[i]; j < lg.indices[i+1]; j++)
+    {
+      sum += values[lg.edges[j]];
+    }
+    nodes_out[i] = teleport + 0.5f*sum;
+  }
+}
+
+// Serial reference on the whole graph, used on rank 0 for small graphs.
+void serial_reference(const global_graph &g, std::vector<float> &ranks)
+{
+  int n = (int)g.nr_nodes;
+  std::vector<graph_offset_t> indices(n + 1);
+  std::vector<graph_node_t> edges(g.edges_before(n));
+  for(int i = 0; i < n; i++)
+  {
+    indices[i] = g.edges_before(i);
+    for(unsigned long long j = g.edges_before(i); j < g.edges_before(i+1); j++) edges[j] = g.source(j);
+  }
+  indices[n] = edges.size();
+  std::vector<float> inv(n);
+  if(g.file_indices)
+  {
+    host_graph_inv_out_degree(&indices[0], edges.empty() ? 0 : &edges[0], n, &inv[0]);
+  }
+  else
+  {
+    for(int i = 0; i < n; i++) inv[i] = 1.f/(float)(indices[i+1] - indices[i]);
+  }
+  ranks.assign(n, 1.f/(float)n);
+  std::vector<float> next(n);
+  for(int iter = 0; iter < iterations; iter++)
+  {
+    for(int i = 0; i < n; i++)
+    {
+      float sum = 0.f;
+      for(graph_offset_t j = indices[i]; j < indices[i+1]; j++) sum += ranks[edges[j]]*inv[edges[j]];
+      next[i] = 0.5f/(float)n + 0.5f*sum;
+    }
+    ranks.swap(next);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  MPI_SAFE_CALL( MPI_Init(&argc, &argv) );
+  int rank, nr_ranks;
+  MPI_SAFE_CALL( MPI_Comm_rank(MPI_COMM_WORLD, &rank) );
+  MPI_SAFE_CALL( MPI_Comm_size(MPI_COMM_WORLD, &nr_ranks) );
+
+  if(argc < 4)
+  {
+    if(rank == 0) printf("usage: %s nodes_per_rank avg_edges balanced [graph.bin]\n", argv[0]);
+    MPI_SAFE_CALL( MPI_Finalize() );
+    return 1;
+  }
+
+  global_graph g;
+  g.nr_nodes  = atoll(argv[1]) * nr_ranks;
+  g.avg_edges = atoi(argv[2]);
+  g.file_indices = 0;
+  g.file_edges   = 0;
+  bool balanced = atoi(argv[3]) != 0;
+  mapped_graph mapped;
+  if(argc > 4)
+  {
+    if(!host_graph_map_binary(argv[4], mapped))
+    {
+      if(rank == 0) printf("couldn't map graph %s\n", argv[4]);
+      MPI_SAFE_CALL( MPI_Finalize() );
+      return 1;
+    }
+    g.nr_nodes     = mapped.array_length;
+    g.file_indices = mapped.graph_indices;
+    g.file_edges   = mapped.graph_edges;
+  }
+  assert(g.nr_nodes < 0xffffffffLL);
+
+  double setup_start = MPI_Wtime();
+  std::vector<long long> row_split;
+  partition_rows(g, nr_ranks, balanced, row_split);
+  local_graph lg;
+  build_local_graph(g, row_split, rank, lg);
+  MPI_SAFE_CALL( MPI_Barrier(MPI_COMM_WORLD) );
+  double setup_time = MPI_Wtime() - setup_start;
+
+  std::vector<float> nodes_A(lg.nr_local, 1.f/(float)g.nr_nodes);
+  std::vector<float> nodes_B(lg.nr_local);
+  std::vector<float> values(lg.nr_local + lg.ghosts.size());
+  std::vector<float> send_buffer(lg.send_ids.size());
+
+  // a rank can own no rows at all when there are more ranks than rows
+  float *local_A = nodes_A.empty() ? 0 : &nodes_A[0];
+  float *local_B = nodes_B.empty() ? 0 : &nodes_B[0];
+
+  MPI_SAFE_CALL( MPI_Barrier(MPI_COMM_WORLD) );
+  double start = MPI_Wtime();
+  for(int iter = 0; iter < iterations; iter += 2)
+  {
+    distributed_propagate(lg, g.nr_nodes, local_A, local_B, values, send_buffer);
+    distributed_propagate(lg, g.nr_nodes, local_B, local_A, values, send_buffer);
+  }
+  MPI_SAFE_CALL( MPI_Barrier(MPI_COMM_WORLD) );
+  double elapsed = MPI_Wtime() - start;
+
+  // imbalance and communication volume
+  long long local_stats[2] = { (long long)lg.edges.size(), (long long)lg.ghosts.size() };
+  long long max_stats[2], sum_stats[2];
+  MPI_SAFE_CALL( MPI_Reduce(local_stats, max_stats, 2, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD) );
+  MPI_SAFE_CALL( MPI_Reduce(local_stats, sum_stats, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD) );
+  if(rank == 0)
+  {
+    printf("ranks: %d nodes: %lld edges: %lld partition: %s\n", nr_ranks, g.nr_nodes, sum_stats[0], balanced ? "edge-balanced" : "contiguous");
+    printf("setup took %.2f ms, edge imbalance (max/avg) %.3f\n", setup_time * 1000.0, (double)max_stats[0] * nr_ranks / sum_stats[0]);
+    printf("%d sweeps took %.2f ms, %.2f ms per sweep, %.1f Medges/s, %.1f MB exchanged per sweep\n",
+           iterations, elapsed * 1000.0, elapsed * 1000.0 / iterations, sum_stats[0] * iterations / elapsed / 1e6,
+           sum_stats[1] * sizeof(float) / 1e6);
+  }
+
+  // check small graphs against a serial run on rank 0
+  if(g.nr_nodes <= (1 << 22))
+  {
+    std::vector<int> counts(nr_ranks), displs(nr_ranks);
+    for(int r = 0; r < nr_ranks; r++)
+    {
+      counts[r] = (int)(row_split[r+1] - row_split[r]);
+      displs[r] = (int)row_split[r];
+    }
+    std::vector<float> all(rank == 0 ? g.nr_nodes : 1);
+    MPI_SAFE_CALL( MPI_Gatherv(local_A, lg.nr_local, MPI_FLOAT, &all[0], &counts[0], &displs[0], MPI_FLOAT, 0, MPI_COMM_WORLD) );
+    if(rank == 0)
+    {
+      std::vector<float> reference;
+      serial_reference(g, reference);
+      double max_rel = 0.0;
+      for(long long i = 0; i < g.nr_nodes; i++)
+      {
+        max_rel = std::max(max_rel, fabs((double)all[i] - reference[i]) / fabs((double)reference[i]));
+      }
+      printf("max relative difference to serial reference %.2e\n", max_rel);
+    }
+  }
+
+  if(g.file_indices) host_graph_unmap_binary(mapped);
+  MPI_SAFE_CALL( MPI_Finalize() );
+  return 0;
+}
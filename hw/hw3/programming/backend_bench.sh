@@ -0,0 +1,100 @@
+#!/bin/sh
+# Compare the Thrust backends of the cipher tools (see vigenere-backend.h)
+# on large corpora.
+#
+# Every corpus is blown up to at least -m megabytes by repeating it, then
+# encoded -r times with every backend that has been built (create_cipher
+# for CUDA, *_omp, *_tbb, *_cpp for the host; "make host" builds the host
+# ones). Times are wall clock per run, file I/O included.
+#
+# Only create_cipher is timed: solve_cipher does its counting, key search
+# and decoding in the same OpenMP host code on every backend (see
+# vigenere-backend.h), so its time doesn't depend on the backend. Every
+# backend's solver is still run once, untimed, as a check: the cipher
+# texts of all backends have to be identical and every solver has to get
+# the plain text back.
+#
+# Output is one CSV row per corpus and backend:
+#
+#   corpus,bytes,backend,tool,runs,median_s,min_s,mb_s
+#
+# usage: ./backend_bench.sh [-p period] [-m megabytes] [-r runs] corpus...
+#   defaults: -p 40 -m 256 -r 5
+
+period=40
+megabytes=256
+runs=5
+while getopts p:m:r: opt
+do
+  case $opt in
+    p) period=$OPTARG ;;
+    m) megabytes=$OPTARG ;;
+    r) runs=$OPTARG ;;
+    *) echo "usage: $0 [-p period] [-m megabytes] [-r runs] corpus..." >&2; exit 1 ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ $# -eq 0 ]; then
+  echo "usage: $0 [-p period] [-m megabytes] [-r runs] corpus..." >&2
+  exit 1
+fi
+
+bin=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+backends=""
+for b in cuda omp tbb cpp
+do
+  suffix=_$b
+  [ $b = cuda ] && suffix=
+  [ -x "$bin/create_cipher$suffix" ] && [ -x "$bin/solve_cipher$suffix" ] && backends="$backends $b"
+done
+if [ -z "$backends" ]; then
+  echo "no backend built, run make or make host first" >&2
+  exit 1
+fi
+
+now() { date +%s.%N; }
+
+# time_runs command... : run it $runs times in $work, print "median min"
+time_runs() {
+  : > "$work/times"
+  i=0
+  while [ $i -lt $runs ]
+  do
+    start=$(now)
+    (cd "$work" && "$@" > /dev/null) || return 1
+    end=$(now)
+    echo "$start $end" | awk '{ printf "%.6f\n", $2 - $1 }' >> "$work/times"
+    i=$((i + 1))
+  done
+  sort -n "$work/times" | awk '{ t[NR] = $1 } END { printf "%s %s\n", t[int((NR + 1) / 2)], t[1] }'
+}
+
+echo "corpus,bytes,backend,tool,runs,median_s,min_s,mb_s"
+for corpus in "$@"
+do
+  : > "$work/corpus.txt"
+  while [ $(wc -c < "$work/corpus.txt") -lt $((megabytes * 1024 * 1024)) ]
+  do
+    cat "$corpus" >> "$work/corpus.txt" || exit 1
+  done
+  bytes=$(wc -c < "$work/corpus.txt")
+  tr 'A-Z' 'a-z' < "$work/corpus.txt" | tr -cd 'a-z' > "$work/sanitized.txt"
+  reference=
+  for b in $backends
+  do
+    suffix=_$b
+    [ $b = cuda ] && suffix=
+    timing=$(time_runs "$bin/create_cipher$suffix" corpus.txt $period) || { echo "create_cipher$suffix failed" >&2; exit 1; }
+    set -- $timing
+    echo "$corpus,$bytes,$b,create_cipher,$runs,$1,$2" | awk -F, -v b=$bytes '{ printf "%s,%.1f\n", $0, b / $6 / 1e6 }'
+    sum=$(md5sum < "$work/cipher_text.txt")
+    [ -z "$reference" ] && reference=$sum
+    [ "$sum" = "$reference" ] || echo "$b: cipher text differs from the other backends" >&2
+
+    (cd "$work" && "$bin/solve_cipher$suffix" cipher_text.txt > /dev/null) || { echo "solve_cipher$suffix failed" >&2; exit 1; }
+    cmp -s "$work/plain_text.txt" "$work/sanitized.txt" || echo "$b: solver didn't recover the plain text" >&2
+  done
+done
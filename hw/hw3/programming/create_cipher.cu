@@ -18,8 +18,6 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <thrust/host_vector.h>
-#include <thrust/device_vector.h>
 #include <thrust/remove.h>
 #include <thrust/iterator/transform_iterator.h>
 #include <thrust/iterator/counting_iterator.h> 
@@ -27,6 +25,12 @@
 #include <thrust/random/linear_congruential_engine.h>
 #include <thrust/random/uniform_int_distribution.h>
 #include <thrust/generate.h>
+#include <thrust/transform.h>
+#include <thrust/scan.h>
+#include <thrust/for_each.h>
+
+#include "vigenere-backend.h"
+#include "vigenere-cpu.h"
 
 struct isnot_lowercase_alpha : thrust::unary_function<bool, unsigned char>{
     //TODO: fill in this functional
@@ -51,26 +55,75 @@ struct upper_to_lower : thrust::unary_function<unsigned char, unsigned char>{
 
 //This functional has to be initialized with the period and (a pointer) to the table of
 //shifts.  You will need a constructor.
+//shift is 1..26, so the sum is below 52 and one compare-and-subtract
+//replaces the % 26
 struct apply_shift : thrust::binary_function<unsigned char, unsigned int, unsigned char> {
     //TODO: fill in the functional
     __host__ __device__
     unsigned char operator()(const unsigned char &c, const unsigned int &shift)
     {
-        return ((c - 'a') + shift) % 26 + 'a';
+        unsigned int x = (c - 'a') + shift;
+        return (x >= 26 ? x - 26 : x) + 'a';
     }
 };
 
-struct periodic_shifts_fun : thrust::unary_function<unsigned int, size_t> 
-{ 
-    const unsigned int period; 
-    unsigned int * shifts;
-    periodic_shifts_fun(const unsigned int period, unsigned int * shifts) : period(period), shifts(shifts){} 
-    __host__ __device__ 
-    unsigned int operator()(const size_t i) 
-    { 
-        return shifts[i % period]; 
-    } 
-}; 
+
+// Characters sanitized by one thread in the fused pass below. Big enough
+// that the per-tile scan is tiny, small enough to leave plenty of tiles for
+// the threads.
+const size_t sanitize_tile = 256;
+
+// Number of characters of tile t that survive sanitizing.
+struct count_lowercase_fun : thrust::unary_function<size_t, size_t>
+{
+    const unsigned char * text;
+    const size_t length;
+    count_lowercase_fun(const unsigned char * text, const size_t length) : text(text), length(length){}
+    __host__ __device__
+    size_t operator()(const size_t t)
+    {
+        size_t end = (t + 1) * sanitize_tile < length ? (t + 1) * sanitize_tile : length;
+        size_t count = 0;
+        for(size_t i = t * sanitize_tile; i < end; ++i)
+            count += !isnot_lowercase_alpha()(upper_to_lower()(text[i]));
+        return count;
+    }
+};
+
+// Lowercases, filters and shifts tile t in one go, writing its letters to
+// cipher_text from tile_offsets[t] on. The key phase is found once per tile
+// and then just stepped, so there's no modulo per character. With period 0
+// the text is only sanitized.
+struct sanitize_encrypt_fun
+{
+    const unsigned char * text;
+    const size_t length;
+    const size_t * tile_offsets;
+    const unsigned int period;
+    const unsigned int * shifts;
+    unsigned char * cipher_text;
+    sanitize_encrypt_fun(const unsigned char * text, const size_t length, const size_t * tile_offsets,
+                         const unsigned int period, const unsigned int * shifts, unsigned char * cipher_text)
+        : text(text), length(length), tile_offsets(tile_offsets), period(period), shifts(shifts), cipher_text(cipher_text){}
+    __host__ __device__
+    void operator()(const size_t t)
+    {
+        size_t end = (t + 1) * sanitize_tile < length ? (t + 1) * sanitize_tile : length;
+        size_t out = tile_offsets[t];
+        unsigned int phase = period ? out % period : 0;
+        for(size_t i = t * sanitize_tile; i < end; ++i)
+        {
+            unsigned char c = upper_to_lower()(text[i]);
+            if(isnot_lowercase_alpha()(c)) continue;
+            if(period)
+            {
+                c = apply_shift()(c, shifts[phase]);
+                if(++phase == period) phase = 0;
+            }
+            cipher_text[out++] = c;
+        }
+    }
+};
 
 
 int main(int argc, char **argv) {
@@ -98,28 +151,9 @@ int main(int argc, char **argv) {
 
     unsigned int period = atoi(argv[2]);
 
-    //sanitize input to contain only a-z lowercase
-    thrust::device_vector<unsigned char> dText = text;
-    thrust::device_vector<unsigned char> plain_text(text.size());
-    
-    //TODO: With one thrust call, generate the cleaned output text which only has lowercase letters
-    //all spaces, etc. removed and uppercase letters converted to lowercase
-    //this result should end up in plain_text
- 
-    //TODO: make sure this gets set to the right value
-    //the number of characters in the cleaned output
-    int numElements = thrust::remove_copy_if(  thrust::make_transform_iterator(dText.begin(), upper_to_lower()), 
-                             thrust::make_transform_iterator(dText.end(),   upper_to_lower()), 
-                             plain_text.begin(), isnot_lowercase_alpha()) - plain_text.begin();
-                             
-    thrust::host_vector<unsigned char> host_cipher_text;
-    if( period == 0){
-        host_cipher_text = plain_text;
-    }  
-    else{
-        
-        thrust::device_vector<unsigned int> shifts(period);
-
+    //the key is drawn on the host, as it has to be printed anyway
+    std::vector<unsigned int> shifts(period);
+    if(period != 0){
         //TODO: Use thrust's random number generation capability to initialize the shift vector
         // Create a minstd_rand object to act as our source of randomness
         thrust::minstd_rand rng;
@@ -128,25 +162,62 @@ int main(int argc, char **argv) {
         std::cout<<"Key: ";
         for(int i=0;i<period;++i){ shifts[i] = dist(rng); std::cout<<(unsigned char) ((shifts[i]==26)?'z': shifts[i] +'a');}
         std::cout<<"\n";
-        
-        thrust::device_vector<unsigned char> device_cipher_text(numElements);
-
-        //TODO: Again, with one thrust call, create the cipher text from the plaintext     
-        thrust::transform_iterator<periodic_shifts_fun, thrust::counting_iterator<size_t>  > 
-            periodic_shifts_iter = thrust::make_transform_iterator(  thrust::make_counting_iterator((size_t)0),
-                                                                     periodic_shifts_fun(period, thrust::raw_pointer_cast(&shifts[0]))); 
-                    
-        thrust::transform(  plain_text.begin(), 
-                            plain_text.begin() + numElements, 
-                            periodic_shifts_iter,
-                            device_cipher_text.begin(), apply_shift());
-
-        host_cipher_text = device_cipher_text;
     }
-    
+
+    //sanitize input to contain only a-z lowercase and encode it, fused into
+    //one pass that writes straight into the cipher text. The text is cut
+    //into tiles; a first read-only pass counts the letters in every tile,
+    //a scan over the counts gives every tile its output offset (a parallel
+    //prefix-sum compaction), and the fused pass then lowercases, filters
+    //and shifts each tile into place. No sanitized copy is ever stored.
+    //Everything runs on the backend chosen in vigenere-backend.h; on a host
+    //backend the mirrors are the host vectors themselves, so nothing is
+    //copied.
+    cipher_mirror<unsigned char> dText(text);
+    cipher_mirror<unsigned int> dShifts(shifts);
+    dText.upload();
+    dShifts.upload();
+    const size_t nr_tiles = (text.size() + sanitize_tile - 1) / sanitize_tile;
+    cipher_vector<size_t>::type tile_offsets(nr_tiles + 1, 0);
+    thrust::transform(  cipher_system(),
+                        thrust::make_counting_iterator((size_t)0),
+                        thrust::make_counting_iterator(nr_tiles),
+                        tile_offsets.begin(),
+                        count_lowercase_fun(dText.data(), text.size()));
+    thrust::exclusive_scan(cipher_system(), tile_offsets.begin(), tile_offsets.end(), tile_offsets.begin());
+
+    //the number of characters in the cleaned output
+    int numElements = tile_offsets[nr_tiles];
+
+    //on the GPU the shift is fused into the compaction. On a host backend
+    //the compaction only sanitizes and the key is applied afterwards with
+    //the SIMD engine of vigenere-cpu.h: the per-letter scalar shift costs
+    //more than the extra pass over the (already compacted) cipher text
+#if CIPHER_BACKEND == CIPHER_BACKEND_CUDA
+    const unsigned int fused_period = period;
+#else
+    const unsigned int fused_period = 0;
+#endif
+    std::vector<unsigned char> cipher_text(numElements);
+    cipher_mirror<unsigned char> device_cipher_text(cipher_text);
+    if(numElements > 0){
+        thrust::for_each(   cipher_system(),
+                            thrust::make_counting_iterator((size_t)0),
+                            thrust::make_counting_iterator(nr_tiles),
+                            sanitize_encrypt_fun(dText.data(), text.size(),
+                                                 thrust::raw_pointer_cast(&tile_offsets[0]), fused_period,
+                                                 fused_period ? dShifts.data() : 0, device_cipher_text.data()));
+        device_cipher_text.download();
+        if(period != fused_period){
+            vigenere_key key;
+            host_vigenere_key(&shifts[0], period, false, key);
+            host_vigenere_apply_omp(&cipher_text[0], &cipher_text[0], numElements, key);
+        }
+    }
+
     std::ofstream ofs("cipher_text.txt", std::ios::binary);
 
-    ofs.write((char *)&host_cipher_text[0], numElements);
+    if(numElements > 0) ofs.write((char *)&cipher_text[0], numElements);
 
     ofs.close();
 
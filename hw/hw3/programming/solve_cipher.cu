@@ -16,7 +16,6 @@
 
 #include <vector>
 #include <thrust/host_vector.h>
-#include <thrust/device_vector.h>
 #include <thrust/remove.h>
 #include <thrust/sort.h>
 #include <thrust/reduce.h>
@@ -27,6 +26,11 @@
 #include <fstream>
 #include <iostream>
 
+#include "vigenere-backend.h"
+#include "vigenere-cpu.h"
+#include "vigenere-analysis.h"
+#include "vigenere-batch.h"
+
 //You will find this strided_range iterator useful
 //foo = [0 1 2 3 4 5 6 7 8]
 //strided_range(foo.begin(), 2) -> [0, 2, 4, 6, 8]
@@ -79,28 +83,24 @@ class strided_range
     Iterator last;
 };
 
-struct periodic_shifts_fun : thrust::unary_function<unsigned int, size_t> 
-{ 
-    const unsigned int period; 
-    unsigned int * shifts;
-    periodic_shifts_fun(const unsigned int period, unsigned int * shifts) : period(period), shifts(shifts){} 
-    __host__ __device__ 
-    unsigned int operator()(const size_t i) 
-    { 
-        return shifts[i % period]; 
-    } 
-}; 
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Run command: ./solve_cipher cipher_text.txt\n"
+               "         or: ./solve_cipher -b manifest [threads]\n");
+        exit(0);
+    }
 
-struct apply_shift : thrust::binary_function<unsigned char, unsigned int, unsigned char> {
-    //TODO: fill in the functional
-    __host__ __device__
-    unsigned char operator()(const unsigned char &c, const unsigned int &shift)
-    {
-        return ((c - 'a') + (26-shift)) % 26 + 'a';
+    //batch mode: crack every file in the manifest on a thread pool (see
+    //vigenere-batch.h), one result line per file on stdout
+    if (strcmp(argv[1], "-b") == 0 && argc >= 3) {
+        long failed = host_crack_batch(argv[2], argc > 3 ? atoi(argv[3]) : 0, stdout);
+        if (failed < 0) {
+            std::cerr << "Couldn't read manifest!" << std::endl;
+            return 1;
+        }
+        return failed ? 2 : 0;
     }
-};
 
-int main(int argc, char **argv) {
     //First load the text 
     std::ifstream ifs(argv[1], std::ios::binary);
     if (!ifs.good()) {
@@ -119,8 +119,6 @@ int main(int argc, char **argv) {
 
     ifs.close();
     
-    thrust::device_vector<unsigned char> device_cipher_text = text;
-    
     //we assume the cipher text has been sanitized
     //generate the frequency table
     //print out all 26 letters and their frequency
@@ -128,26 +126,20 @@ int main(int argc, char **argv) {
     //b: .02
     //...
 
-    // Since the number of bins is extreamly small (well, only 26) 
-    // compared to the input size, using the binary search for dense 
-    // histogram will be faster than the example using the reduced_by_key
-    // in the lecture note. Here, I implemented the binary search version.
-    
-    thrust::device_vector<unsigned char> data = device_cipher_text;
-    thrust::sort(data.begin(), data.end());
-    thrust::device_vector<size_t> histogram(26);
-    thrust::counting_iterator<unsigned char> counting_iter('a');
-    thrust::upper_bound(data.begin(), data.end(), counting_iter, counting_iter + 26, histogram.begin());
-    thrust::host_vector<size_t> host_histogram = histogram;
+    // All three tables come from one multithreaded pass over the text on
+    // the host: every thread counts its chunk into private unigram, bigram
+    // and trigram tables and the tables are summed afterwards (see
+    // vigenere-analysis.h). That is linear work, where sorting the text to
+    // count 26 bins was O(n log n).
+    thrust::host_vector<size_t> host_histogram(26);
+    thrust::host_vector<size_t> host_digraphs(26*26);
+    thrust::host_vector<size_t> host_trigraphs(26*26*26);
+    host_letter_histograms(&text[0], text.size(), &host_histogram[0], &host_digraphs[0], &host_trigraphs[0]);
     std::cout<<"Text length: "<<length<<"\n\n";
     size_t result = 0;
     for(int i=0; i<26;i++)
     {  
-        size_t count = 0;
-        if( i == 0)
-        { count = host_histogram[i]; }
-        else
-        { count = host_histogram[i]-host_histogram[i-1]; }
+        size_t count = host_histogram[i];
         result += count;
         std::cout <<(unsigned char) (i +'a')<<": "<<double(count)/double(length)<<"\n";
     }
@@ -159,110 +151,77 @@ int main(int argc, char **argv) {
     //tl: .0009
     //...
 
-    thrust::host_vector<size_t>  host_data = device_cipher_text;
     thrust::host_vector<unsigned int> host_key(26*26);
-    host_histogram.resize(26*26);
-    for(int i=0; i<26*26; ++i) {host_histogram[i] = 0;host_key[i]=i;}
-    // It seems that the most efficent way to do digraph table is 
-    // doing the forloop. 
-    for(size_t i=0; i<length-1; ++i)
+    for(int i=0; i<26*26; ++i) {host_key[i]=i;}
+    thrust::sort_by_key(cipher_host_system(), host_digraphs.begin(), host_digraphs.end(), host_key.begin(),thrust::greater<size_t>());
+    size_t sum = thrust::reduce(cipher_host_system(), host_digraphs.begin(), host_digraphs.end(), (size_t) 0, thrust::plus<size_t>());
+
+    for(int i=0; i<20; i++)
     {
-        unsigned char m = host_data[i]-'a';
-        unsigned char n = host_data[i+1]-'a';
-        host_histogram[m*26 + n]++;
+        unsigned char m = host_key[i]/26 + 'a';
+        unsigned char n = host_key[i]%26 + 'a';
+        std::cout<<m<<n<<": "<<" "<<double(host_digraphs[i])/double(sum)<<"\n";
     }
-    thrust::sort_by_key(host_histogram.begin(), host_histogram.end(), host_key.begin(),thrust::greater<int>());
-    size_t sum = thrust::reduce(host_histogram.begin(), host_histogram.end(), (size_t) 0, thrust::plus<int>());
 
+    //and the top 20 trigraphs
+    thrust::host_vector<unsigned int> host_trigraph_key(26*26*26);
+    for(int i=0; i<26*26*26; ++i) {host_trigraph_key[i]=i;}
+    thrust::sort_by_key(cipher_host_system(), host_trigraphs.begin(), host_trigraphs.end(), host_trigraph_key.begin(),thrust::greater<size_t>());
+    size_t trigraph_sum = thrust::reduce(cipher_host_system(), host_trigraphs.begin(), host_trigraphs.end(), (size_t) 0, thrust::plus<size_t>());
+    std::cout<<"\n";
     for(int i=0; i<20; i++)
     {
-        unsigned char n = (host_key[i]%26) + 'a';
-        unsigned char m = (host_key[i] - n + 'a')/26 + 'a';
-        std::cout<<m<<n<<": "<<" "<<double(host_histogram[i])/double(sum)<<"\n";
+        unsigned char l = host_trigraph_key[i]/(26*26) + 'a';
+        unsigned char m = host_trigraph_key[i]/26%26 + 'a';
+        unsigned char n = host_trigraph_key[i]%26 + 'a';
+        std::cout<<l<<m<<n<<": "<<" "<<double(host_trigraphs[i])/double(trigraph_sum)<<"\n";
     }
     
     //now we need to crack vignere cipher
     //first we need to determine the key length
     //use the index of coincidence
-    unsigned int keyLength = 0;
-    {
-        bool found = false;
-        int i = 1;
-        while (!found) {
-            //TODO: set this to the correct value
-            int numMatches = thrust::inner_product( device_cipher_text.begin(), device_cipher_text.end()-i, device_cipher_text.begin()+i, 
-                                                    (int)0,thrust::plus<int>(), thrust::equal_to<int>());
-            double ioc = numMatches / ((double)(text.size() - i) / 26.); 
-            if (ioc > 1.6) {
-                if (keyLength == 0)
-                    keyLength = i;
-                else if (2 * keyLength == i)
-                    found = true;
-                else {
-                    std::cout << "Unusual pattern in text!" << std::endl;
-                    exit(1);
-                }
-            }
-            ++i; 
-        }
+    //the coincidence counts of all shifts up to some maximum come out of
+    //one cache-blocked pass over the text (see vigenere-analysis.h), rather
+    //than one inner_product per shift; if the pattern isn't complete by
+    //then, the maximum is doubled
+    const char *error = 0;
+    std::vector<size_t> coincidences;
+    unsigned int keyLength = host_key_length(&text[0], text.size(), coincidences, &error);
+    if (keyLength == 0) {
+        std::cout << error << std::endl;
+        exit(1);
     }
 
     std::cout << "\nkeyLength: " << keyLength << std::endl;
 
     //once we know the key length, then we can do frequency analysis on each pos mod length
     //allowing us to easily break each cipher independently
-    thrust::device_vector<unsigned int> dShifts(keyLength);
-    thrust::host_vector<unsigned char>   host_partial_data((device_cipher_text.size()+keyLength-1)/keyLength );
-    thrust::device_vector<unsigned char> partial_data     ((device_cipher_text.size()+keyLength-1)/keyLength );
+    //all columns are counted in one pass into a [keyLength x 26] table,
+    //and all 26 shifts of every column are scored against English letter
+    //frequencies at once (see vigenere-analysis.h), instead of copying,
+    //uploading and sorting every column on its own
+    //the shifts are found and used on the host, so dShifts stays there on
+    //every backend
+    thrust::host_vector<unsigned int> dShifts(keyLength);
     ////TODO: set the dShifts vector correctly
-    // typedef thrust::device_vector<unsigned char>::iterator Iterator;
-    for (int i = 0; i < keyLength; ++i) 
-    {        
-        int edge_case_shift = 0;
-        for(int j = 0; j< (device_cipher_text.size()+keyLength-1)/keyLength; ++j)
-        {
-            if( (j*keyLength+i) < device_cipher_text.size()){  host_partial_data[j] = text[j*keyLength + i];}
-            else{  host_partial_data[j] = 0;edge_case_shift=1;}
-        }
-        partial_data = host_partial_data;
-        
-        thrust::sort(partial_data.begin(), partial_data.end()-edge_case_shift);
-        thrust::device_vector<size_t> histogram(26);
-        thrust::counting_iterator<unsigned char> counting_iter('a');
-        thrust::upper_bound(partial_data.begin(), partial_data.end()-edge_case_shift, counting_iter, counting_iter + 26, histogram.begin());
-        thrust::host_vector<size_t> host_histogram = histogram;
-        thrust::host_vector<size_t> host_count(26);
-        thrust::host_vector<size_t> host_key(26);
-        for(int k=0; k<26;++k)
-        {
-            host_key[k]=k;
-            size_t count = 0;
-            if( k == 0){ count = host_histogram[k]; }
-            else{ count = host_histogram[k]-host_histogram[k-1]; }    
-            host_count[k] = count;
-        }
-        thrust::sort_by_key(host_count.begin(), host_count.end(), host_key.begin(),thrust::greater<int>());
-        int shift = host_key[0] + 'a' - 'e'; 
-        if(shift > 0){ dShifts[i] = shift;}
-        else{ dShifts[i] = (shift + 26) ;}
+    {
+        std::vector<size_t> column_counts;
+        std::vector<double> scores;
+        host_key_shifts(&text[0], text.size(), keyLength, column_counts, scores, &dShifts[0]);
     }
     std::cout<<"\nKey: ";
     for(int i=0;i<keyLength;++i){ std::cout<<(unsigned char) ((dShifts[i]==26)?'z': dShifts[i] +'a');}
     std::cout<<"\n\n";
         
-    thrust::device_vector<unsigned char> d_plain_text(text.size());
-
     //TODO: use the dShifts vector to generate the plaintext
-    thrust::transform_iterator<periodic_shifts_fun, thrust::counting_iterator<size_t>  > 
-        periodic_shifts_iter = thrust::make_transform_iterator(  thrust::make_counting_iterator((size_t)0),
-                                                                 periodic_shifts_fun(keyLength, thrust::raw_pointer_cast(&dShifts[0]))); 
-                                                             
-    thrust::transform(  device_cipher_text.begin(), 
-                        device_cipher_text.end(), 
-                        periodic_shifts_iter,
-                        d_plain_text.begin(), apply_shift());
-
-    thrust::host_vector<unsigned char> h_plain_text = d_plain_text; 
+    //decoded on the host straight from the text we read: the key is
+    //expanded into a repeating key stream and applied with SIMD byte adds
+    //(see vigenere-cpu.h), instead of a shifts[i % keyLength] lookup and a
+    //% 26 per character
+    vigenere_key key;
+    host_vigenere_key(&dShifts[0], keyLength, true, key);
+    thrust::host_vector<unsigned char> h_plain_text(text.size());
+    host_vigenere_apply_omp(&text[0], &h_plain_text[0], text.size(), key);
 
     std::ofstream ofs("plain_text.txt", std::ios::binary);
     
@@ -0,0 +1,395 @@
+// Multithreaded CPU statistics for cracking a Vigenere cipher text.
+//
+// Everything here is a counting problem over a sanitized text ('a'..'z'),
+// so instead of sorting the text every thread counts its own chunk into
+// private tables in one streaming pass and the tables are summed at the
+// end. The work is linear in the text and bound by memory bandwidth.
+//
+// Only needs a C++ compiler with OpenMP, so it can be built without nvcc.
+
+#ifndef VIGENERE_ANALYSIS_H
+#define VIGENERE_ANALYSIS_H
+
+#include <vector>
+#include <complex>
+#include <stddef.h>
+#include <math.h>
+#include "omp.h"
+
+// Sum nr_tables tables of bins counts each (laid out one after the other)
+// into result.
+inline void host_merge_tables(const size_t *tables, int nr_tables, size_t bins, size_t *result)
+{
+  #pragma omp parallel for schedule(static)
+  for(long long b = 0; b < (long long)bins; b++)
+  {
+    size_t sum = 0;
+    for(int t = 0; t < nr_tables; t++) sum += tables[t * bins + b];
+    result[b] = sum;
+  }
+}
+
+// Unigram (26), bigram (26*26) and trigram (26*26*26) counts of text in
+// one pass; bigram ab is at a*26+b, trigram abc at (a*26+b)*26+c. The
+// indices are rolled along (trigram = previous bigram * 26 + c), so there
+// is no modulo per character. Characters outside 'a'..'z' aren't counted
+// and break the runs, so no bi- or trigram spans them.
+inline void host_letter_histograms(const unsigned char *text, size_t length,
+                                   size_t *unigrams, size_t *bigrams, size_t *trigrams)
+{
+  const int nr_threads = omp_get_max_threads();
+  const size_t uni = 26, bi = 26*26, tri = 26*26*26;
+  std::vector<size_t> tables((size_t)nr_threads * (uni + bi + tri), 0);
+
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    int t = omp_get_thread_num();
+    size_t *u = &tables[(size_t)t * uni];
+    size_t *b = &tables[(size_t)nr_threads * uni + (size_t)t * bi];
+    size_t *g = &tables[(size_t)nr_threads * (uni + bi) + (size_t)t * tri];
+    size_t chunk = (length + nr_threads - 1) / nr_threads;
+    size_t begin = (size_t)t * chunk < length ? (size_t)t * chunk : length;
+    size_t end = begin + chunk < length ? begin + chunk : length;
+
+    // the run of letters leading into the chunk, so the grams that start
+    // in the previous chunk and end in ours are counted here
+    size_t start = begin >= 2 ? begin - 2 : 0;
+    int run = 0;               // letters in the current run, up to 2
+    unsigned int prev = 0;     // last letter
+    unsigned int prev_bi = 0;  // last bigram
+    for(size_t i = start; i < end; i++)
+    {
+      unsigned int c = text[i] - 'a';
+      if(c >= 26) { run = 0; continue; }
+      if(i >= begin)
+      {
+        u[c]++;
+        if(run >= 1) b[prev * 26 + c]++;
+        if(run >= 2) g[prev_bi * 26 + c]++;
+      }
+      prev_bi = prev * 26 + c;
+      prev = c;
+      if(run < 2) run++;
+    }
+  }
+
+  host_merge_tables(&tables[0], nr_threads, uni, unigrams);
+  host_merge_tables(&tables[(size_t)nr_threads * uni], nr_threads, bi, bigrams);
+  host_merge_tables(&tables[(size_t)nr_threads * (uni + bi)], nr_threads, tri, trigrams);
+}
+
+// Characters per block of the coincidence count: a block plus the max_shift
+// characters after it stay in L1 while it is compared at every shift.
+const size_t coincidence_block = 8192;
+
+// counts[s] = number of positions j with text[j] == text[j+s], for every
+// shift 1..max_shift (counts[0] is left 0), in one pass over the text.
+// Instead of one pass per shift, the text is cut into blocks and each
+// block is compared against all shifts while it is in cache; blocks go to
+// the threads, which count into private rows that are merged at the end.
+inline void host_coincidences(const unsigned char *text, size_t length, int max_shift, size_t *counts)
+{
+  const int nr_threads = omp_get_max_threads();
+  const size_t row = max_shift + 1;
+  std::vector<size_t> tables((size_t)nr_threads * row, 0);
+  const long long nr_blocks = (long long)((length + coincidence_block - 1) / coincidence_block);
+
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    size_t *c = &tables[(size_t)omp_get_thread_num() * row];
+    #pragma omp for schedule(static)
+    for(long long k = 0; k < nr_blocks; k++)
+    {
+      size_t begin = (size_t)k * coincidence_block;
+      size_t end = begin + coincidence_block < length ? begin + coincidence_block : length;
+      for(int s = 1; s <= max_shift; s++)
+      {
+        // positions with j + s < length
+        size_t stop = length > (size_t)s ? length - s : 0;
+        if(stop > end) stop = end;
+        const unsigned char *a = text, *b = text + s;
+        unsigned int matches = 0;  // at most coincidence_block
+        for(size_t j = begin; j < stop; j++) matches += a[j] == b[j];
+        c[s] += matches;
+      }
+    }
+  }
+  host_merge_tables(&tables[0], nr_threads, row, counts);
+  counts[0] = 0;
+}
+
+// In-place radix-2 FFTs without the bit reversal permutation: the forward
+// transform (decimation in frequency) takes natural order and leaves the
+// spectrum in bit-reversed order, and the inverse (decimation in time, 1/n
+// left out) takes bit-reversed order back to natural order. Anything done
+// elementwise in between doesn't care about the order, and the permutation
+// is a cache miss per element on a large array.
+//
+// The stages on blocks of more than fft_block points are full passes over
+// the array; after that (before, for the inverse) the blocks are
+// independent and each one runs all of its small stages while it sits in
+// L2, so a large transform costs a handful of passes instead of log2(n).
+// Every stage reads its twiddles from a packed copy, in order.
+const size_t fft_block = 1 << 14;
+
+// One butterfly stage on blocks of len points, w holds the len/2 twiddles.
+inline void host_fft_stage_forward(std::complex<double> *x, size_t count, size_t len, const std::complex<double> *w)
+{
+  const size_t half = len / 2;
+  for(size_t i = 0; i < count; i += len)
+  {
+    for(size_t j = 0; j < half; j++)
+    {
+      // multiplied out by hand; operator* checks for NaNs through a call
+      double wr = w[j].real(), wi = w[j].imag();
+      std::complex<double> u = x[i + j], v = x[i + j + half];
+      double dr = u.real() - v.real(), di = u.imag() - v.imag();
+      x[i + j] = u + v;
+      x[i + j + half] = std::complex<double>(dr*wr - di*wi, dr*wi + di*wr);
+    }
+  }
+}
+
+inline void host_fft_stage_inverse(std::complex<double> *x, size_t count, size_t len, const std::complex<double> *w)
+{
+  const size_t half = len / 2;
+  for(size_t i = 0; i < count; i += len)
+  {
+    for(size_t j = 0; j < half; j++)
+    {
+      double wr = w[j].real(), wi = -w[j].imag();
+      double xr = x[i + j + half].real(), xi = x[i + j + half].imag();
+      std::complex<double> u = x[i + j], v(xr*wr - xi*wi, xr*wi + xi*wr);
+      x[i + j] = u + v;
+      x[i + j + half] = u - v;
+    }
+  }
+}
+
+// Twiddles of a transform of n points packed per stage: the len/2 twiddles
+// of the stage on blocks of len points start at offset len/2 - 1 for
+// len = 2..n (n - 1 in all).
+struct fft_plan
+{
+  size_t n;
+  std::vector<std::complex<double> > twiddles;
+
+  const std::complex<double> *stage(size_t len) const { return &twiddles[len/2 - 1]; }
+};
+
+inline void host_fft_plan(size_t n, fft_plan &plan)
+{
+  plan.n = n;
+  plan.twiddles.resize(n - 1);
+  for(size_t len = 2; len <= n; len <<= 1)
+  {
+    std::complex<double> *w = &plan.twiddles[len/2 - 1];
+    for(size_t j = 0; j < len/2; j++)
+    {
+      double angle = -2.0 * M_PI * (double)j / (double)len;
+      w[j] = std::complex<double>(cos(angle), sin(angle));
+    }
+  }
+}
+
+inline void host_fft_forward(std::complex<double> *x, const fft_plan &plan)
+{
+  const size_t n = plan.n;
+  size_t len = n;
+  for(; len > fft_block; len >>= 1) host_fft_stage_forward(x, n, len, plan.stage(len));
+  for(size_t b = 0; b < n; b += len)
+  {
+    for(size_t l = len; l >= 2; l >>= 1) host_fft_stage_forward(x + b, len, l, plan.stage(l));
+  }
+}
+
+inline void host_fft_inverse(std::complex<double> *x, const fft_plan &plan)
+{
+  const size_t n = plan.n;
+  const size_t block = n < fft_block ? n : fft_block;
+  for(size_t b = 0; b < n; b += block)
+  {
+    for(size_t l = 2; l <= block; l <<= 1) host_fft_stage_inverse(x + b, block, l, plan.stage(l));
+  }
+  for(size_t len = block * 2; len <= n; len <<= 1) host_fft_stage_inverse(x, n, len, plan.stage(len));
+}
+
+// Above this many shifts host_coincidences_fft beats host_coincidences
+// (about 10-20 thousand on texts of a few million characters).
+const int coincidence_fft_shift = 16384;
+
+// Same counts as host_coincidences through autocorrelation: the matches at
+// shift s are the sum over the 26 letters of the autocorrelation of that
+// letter's indicator sequence, which is the inverse FFT of the summed power
+// spectra. Two letters share one complex FFT, one in the real and one in
+// the imaginary part: their power spectra add up to (S_k + S_-k)/2 with
+// S = |Z|^2, and as S is real the inverse of that is just the real part of
+// the inverse of S. So it takes 13 forward and one inverse FFT of twice
+// the text length, O(n log n) whatever max_shift is. It needs 24 bytes per
+// padded character per thread.
+inline void host_coincidences_fft(const unsigned char *text, size_t length, int max_shift, size_t *counts)
+{
+  size_t n = 2;
+  while(n < length + (size_t)max_shift + 1) n <<= 1;
+  const int nr_threads = omp_get_max_threads();
+  std::vector<double> power((size_t)nr_threads * n, 0.0);
+  fft_plan plan;
+  host_fft_plan(n, plan);
+
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    std::vector<std::complex<double> > z(n);
+    double *p = &power[(size_t)omp_get_thread_num() * n];
+    #pragma omp for schedule(dynamic)
+    for(int pair = 0; pair < 13; pair++)
+    {
+      const unsigned char re = 'a' + 2*pair, im = re + 1;
+      for(size_t j = 0; j < n; j++)
+      {
+        z[j] = j < length ? std::complex<double>(text[j] == re, text[j] == im) : 0.0;
+      }
+      host_fft_forward(&z[0], plan);
+      // bit-reversed order, same for every pair
+      for(size_t k = 0; k < n; k++) p[k] += std::norm(z[k]);
+    }
+  }
+
+  std::vector<std::complex<double> > r(n);
+  for(size_t k = 0; k < n; k++)
+  {
+    double sum = 0.0;
+    for(int t = 0; t < nr_threads; t++) sum += power[(size_t)t * n + k];
+    r[k] = sum;
+  }
+  host_fft_inverse(&r[0], plan);
+  counts[0] = 0;
+  for(int s = 1; s <= max_shift; s++)
+  {
+    double c = r[s].real() / (double)n;
+    counts[s] = c > 0.0 ? (size_t)(c + 0.5) : 0;
+  }
+}
+
+// counts[p*26 + c] = occurrences of letter c at the positions j with
+// j % period == p, in one pass. The phase is stepped along rather than
+// computed per character, and the chunks are whole multiples of the period
+// so every thread starts at phase 0 with its own table.
+inline void host_column_histograms(const unsigned char *text, size_t length, unsigned int period, size_t *counts)
+{
+  const int nr_threads = omp_get_max_threads();
+  const size_t bins = (size_t)period * 26;
+  std::vector<size_t> tables((size_t)nr_threads * bins, 0);
+  size_t chunk = (length + nr_threads - 1) / nr_threads;
+  chunk = (chunk + period - 1) / period * period;
+
+  #pragma omp parallel num_threads(nr_threads)
+  {
+    int t = omp_get_thread_num();
+    size_t *table = &tables[(size_t)t * bins];
+    size_t begin = (size_t)t * chunk < length ? (size_t)t * chunk : length;
+    size_t end = begin + chunk < length ? begin + chunk : length;
+    size_t *column = table, *last = table + bins;
+    for(size_t i = begin; i < end; i++)
+    {
+      unsigned int c = text[i] - 'a';
+      if(c < 26) column[c]++;
+      column += 26;
+      if(column == last) column = table;
+    }
+  }
+  host_merge_tables(&tables[0], nr_threads, bins, counts);
+}
+
+// Letter frequencies of English text, a to z.
+const double english_frequencies[26] = {
+  0.08167, 0.01492, 0.02782, 0.04253, 0.12702, 0.02228, 0.02015, 0.06094, 0.06966,
+  0.00153, 0.00772, 0.04025, 0.02406, 0.06749, 0.07507, 0.01929, 0.00095, 0.05987,
+  0.06327, 0.09056, 0.02758, 0.00978, 0.02360, 0.00150, 0.01974, 0.00074
+};
+
+// Score every shift of every column against English at once:
+// scores[p*26 + s] is the correlation of column p, shifted back by s, with
+// english_frequencies. Returns the best shift of every column in
+// best_shifts (0..25).
+inline void host_score_shifts(const size_t *counts, unsigned int period, double *scores, unsigned int *best_shifts)
+{
+  #pragma omp parallel for schedule(static)
+  for(long long p = 0; p < (long long)period; p++)
+  {
+    const size_t *column = counts + p * 26;
+    double *score = scores + p * 26;
+    unsigned int best = 0;
+    for(unsigned int s = 0; s < 26; s++)
+    {
+      // cipher letter c comes from plain letter c - s
+      double sum = 0.0;
+      for(unsigned int c = 0, plain = 26 - s; c < 26; c++)
+      {
+        if(plain == 26) plain = 0;
+        sum += column[c] * english_frequencies[plain++];
+      }
+      score[s] = sum;
+      if(sum > score[best]) best = s;
+    }
+    best_shifts[p] = best;
+  }
+}
+
+// The key length by the index of coincidence: the first shift whose
+// coincidence count is well above that of random text (ioc > 1.6),
+// confirmed by the same at twice that shift. The counts come in blocks of
+// shifts that double until the pattern is complete, through the FFT once
+// that is cheaper. coincidences is scratch space, kept by the caller so
+// it can be reused. Returns 0 and sets *error if there's no key length.
+inline unsigned int host_key_length(const unsigned char *text, size_t length, std::vector<size_t> &coincidences,
+                                    const char **error)
+{
+  unsigned int key_length = 0;
+  int max_shift = 0;
+  for(int i = 1; ; i++)
+  {
+    if(i > max_shift)
+    {
+      if((size_t)i >= length)
+      {
+        *error = "No key length found!";
+        return 0;
+      }
+      max_shift = max_shift ? 2 * max_shift : 64;
+      if((size_t)max_shift >= length) max_shift = length - 1;
+      coincidences.resize(max_shift + 1);
+      if(max_shift > coincidence_fft_shift)
+        host_coincidences_fft(text, length, max_shift, &coincidences[0]);
+      else
+        host_coincidences(text, length, max_shift, &coincidences[0]);
+    }
+    double ioc = coincidences[i] / ((double)(length - i) / 26.);
+    if(ioc > 1.6)
+    {
+      if(key_length == 0)
+        key_length = i;
+      else if(2 * key_length == (unsigned int)i)
+        return key_length;
+      else
+      {
+        *error = "Unusual pattern in text!";
+        return 0;
+      }
+    }
+  }
+}
+
+// The key for a known key length, as shifts 1..26 (the cipher tools'
+// convention). counts and scores are scratch space like above.
+inline void host_key_shifts(const unsigned char *text, size_t length, unsigned int period,
+                            std::vector<size_t> &counts, std::vector<double> &scores, unsigned int *shifts)
+{
+  counts.resize((size_t)period * 26);
+  scores.resize((size_t)period * 26);
+  host_column_histograms(text, length, period, &counts[0]);
+  host_score_shifts(&counts[0], period, &scores[0], shifts);
+  for(unsigned int p = 0; p < period; p++)
+    if(shifts[p] == 0) shifts[p] = 26;
+}
+
+#endif
@@ -0,0 +1,105 @@
+// Backend selection for the Thrust cipher tools.
+//
+// The pipelines in create_cipher.cu and solve_cipher.cu don't name
+// device_vector or a memory space themselves: every Thrust call takes
+// cipher_system() (or cipher_host_system() for data that always lives on
+// the host) as its execution policy, and backend memory is a
+// cipher_vector<T>::type. CIPHER_BACKEND picks what those are:
+//
+//   CIPHER_BACKEND_CUDA  the GPU (the default under nvcc)
+//   CIPHER_BACKEND_OMP   host, OpenMP threads (the default otherwise)
+//   CIPHER_BACKEND_TBB   host, Intel TBB tasks
+//   CIPHER_BACKEND_CPP   host, serial
+//
+// The functors are all __host__ __device__ and only see raw pointers, so
+// the same code runs on every backend. On the host backends the input
+// and output std::vectors are used in place through cipher_mirror, so
+// there are no host/device copies at all.
+//
+// Only create_cipher's sanitize/encode pipeline really runs on the chosen
+// backend. solve_cipher's counting, key search and decoding are the
+// OpenMP host code of vigenere-analysis.h and vigenere-cpu.h on every
+// backend; the backend only sorts its small digraph and trigraph tables.
+//
+// The host backends build with a plain C++ compiler and the Thrust
+// headers, with Thrust's device system set to the same backend so no CUDA
+// header is pulled in, e.g.
+//
+//   g++ -x c++ -O3 -fopenmp -DTHRUST_DEVICE_SYSTEM=THRUST_DEVICE_SYSTEM_OMP
+//       -DCIPHER_BACKEND=CIPHER_BACKEND_OMP create_cipher.cu
+//
+// (see the Makefile).
+
+#ifndef VIGENERE_BACKEND_H
+#define VIGENERE_BACKEND_H
+
+#include <vector>
+#include <thrust/copy.h>
+#include <thrust/execution_policy.h>
+
+#define CIPHER_BACKEND_CUDA 1
+#define CIPHER_BACKEND_OMP  2
+#define CIPHER_BACKEND_TBB  3
+#define CIPHER_BACKEND_CPP  4
+
+#ifndef CIPHER_BACKEND
+#ifdef __CUDACC__
+#define CIPHER_BACKEND CIPHER_BACKEND_CUDA
+#else
+#define CIPHER_BACKEND CIPHER_BACKEND_OMP
+#endif
+#endif
+
+#if CIPHER_BACKEND == CIPHER_BACKEND_CUDA
+#include <thrust/device_vector.h>
+typedef thrust::device_system_tag cipher_system;
+typedef thrust::host_system_tag cipher_host_system;
+template <typename T> struct cipher_vector { typedef thrust::device_vector<T> type; };
+const char * const cipher_backend_name = "cuda";
+#elif CIPHER_BACKEND == CIPHER_BACKEND_OMP
+#include <thrust/system/omp/execution_policy.h>
+#include <thrust/system/omp/vector.h>
+typedef thrust::omp::tag cipher_system;
+typedef thrust::omp::tag cipher_host_system;
+template <typename T> struct cipher_vector { typedef thrust::omp::vector<T> type; };
+const char * const cipher_backend_name = "omp";
+#elif CIPHER_BACKEND == CIPHER_BACKEND_TBB
+#include <thrust/system/tbb/execution_policy.h>
+#include <thrust/system/tbb/vector.h>
+typedef thrust::tbb::tag cipher_system;
+typedef thrust::tbb::tag cipher_host_system;
+template <typename T> struct cipher_vector { typedef thrust::tbb::vector<T> type; };
+const char * const cipher_backend_name = "tbb";
+#elif CIPHER_BACKEND == CIPHER_BACKEND_CPP
+#include <thrust/system/cpp/execution_policy.h>
+#include <thrust/system/cpp/vector.h>
+typedef thrust::cpp::tag cipher_system;
+typedef thrust::cpp::tag cipher_host_system;
+template <typename T> struct cipher_vector { typedef thrust::cpp::vector<T> type; };
+const char * const cipher_backend_name = "cpp";
+#else
+#error "unknown CIPHER_BACKEND"
+#endif
+
+// Backend memory for a host std::vector. On the GPU it is a device copy
+// that upload() and download() keep in sync; on a host backend it is the
+// std::vector itself and both do nothing.
+template <typename T>
+struct cipher_mirror
+{
+  std::vector<T> &host;
+#if CIPHER_BACKEND == CIPHER_BACKEND_CUDA
+  thrust::device_vector<T> device;
+  cipher_mirror(std::vector<T> &host) : host(host), device(host.size()) {}
+  void upload() { thrust::copy(host.begin(), host.end(), device.begin()); }
+  void download() { thrust::copy(device.begin(), device.end(), host.begin()); }
+  T *data() { return device.empty() ? 0 : thrust::raw_pointer_cast(&device[0]); }
+#else
+  cipher_mirror(std::vector<T> &host) : host(host) {}
+  void upload() {}
+  void download() {}
+  T *data() { return host.empty() ? 0 : &host[0]; }
+#endif
+};
+
+#endif
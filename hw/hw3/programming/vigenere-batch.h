@@ -0,0 +1,260 @@
+// Cracking many Vigenere cipher texts in one process.
+//
+// The manifest lists one sanitized cipher text per line, optionally
+// followed by where to write its plain text (default: the cipher text's
+// name plus ".plain"). Files are cracked in two groups:
+//
+//   large files  - (at least crack_split_bytes) first, one after the
+//                  other, each with every OpenMP pass split across all
+//                  threads
+//   small files  - then a pool of worker threads takes them one at a time,
+//                  largest first, and each runs the whole crack single
+//                  threaded, so cores are kept busy with whole files and
+//                  nothing is synchronized inside a crack
+//
+// Doing the large files first and the small ones largest first leaves only
+// short tasks for the end of the run, so no single file holds up its tail.
+//
+// Every worker keeps one crack_workspace, whose buffers (text, plain text,
+// coincidence counts, column tables, key stream) only ever grow, so after
+// the first few files there are no allocations left per file. A result
+// line is written and flushed as soon as a file is done, in completion
+// order:
+//
+//   index,cipher_file,bytes,key_length,key,seconds,status
+//
+// status is "ok" or what went wrong; a failed file doesn't stop the batch.
+
+#ifndef VIGENERE_BATCH_H
+#define VIGENERE_BATCH_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "omp.h"
+#include "vigenere-cpu.h"
+#include "vigenere-analysis.h"
+
+// Below this a file is cracked by one thread; the OpenMP passes don't pay
+// for their start-up on less.
+const size_t crack_split_bytes = 1 << 20;
+
+struct crack_job
+{
+  std::string cipher_file, plain_file;
+  size_t bytes;    // size at the time the manifest was read
+};
+
+struct crack_workspace
+{
+  std::vector<unsigned char> text, plain;
+  std::vector<size_t> coincidences, counts;
+  std::vector<double> scores;
+  std::vector<unsigned int> shifts;
+  vigenere_key key;
+};
+
+struct crack_batch
+{
+  std::vector<crack_job> jobs;
+  std::vector<size_t> small;   // indices into jobs, largest first
+  size_t next;                 // next entry of small to hand out
+  pthread_mutex_t lock;        // guards next, out and the counters
+  FILE *out;
+  size_t cracked, failed;
+};
+
+// strerror isn't thread safe; this writes the message for error into
+// buffer (or returns a static string) instead.
+inline const char *host_error_text(int error, char *buffer, size_t size)
+{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+  return strerror_r(error, buffer, size);
+#else
+  if(strerror_r(error, buffer, size) != 0) snprintf(buffer, size, "error %d", error);
+  return buffer;
+#endif
+}
+
+// Orders job indices by decreasing file size.
+struct crack_job_larger
+{
+  const std::vector<crack_job> *jobs;
+  crack_job_larger(const std::vector<crack_job> *jobs) : jobs(jobs) {}
+  bool operator()(size_t a, size_t b) const { return (*jobs)[a].bytes > (*jobs)[b].bytes; }
+};
+
+// Read a whole file into buffer (which is only grown). Returns false with
+// errno set on failure.
+inline bool host_read_file(const char *name, std::vector<unsigned char> &buffer, size_t &length)
+{
+  int fd = open(name, O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0) { int error = errno; close(fd); errno = error; return false; }
+  length = st.st_size;
+  if(buffer.size() < length) buffer.resize(length);
+  size_t done = 0;
+  while(done < length)
+  {
+    ssize_t got = read(fd, &buffer[done], length - done);
+    if(got < 0 && errno == EINTR) continue;
+    if(got <= 0) { int error = got < 0 ? errno : EIO; close(fd); errno = error; return false; }
+    done += got;
+  }
+  close(fd);
+  return true;
+}
+
+inline bool host_write_file(const char *name, const unsigned char *data, size_t length)
+{
+  int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) return false;
+  size_t done = 0;
+  while(done < length)
+  {
+    ssize_t put = write(fd, data + done, length - done);
+    if(put < 0 && errno == EINTR) continue;
+    if(put < 0) { int error = errno; close(fd); errno = error; return false; }
+    done += put;
+  }
+  return close(fd) == 0;
+}
+
+// Crack one file with the calling thread's OpenMP thread count and write
+// its result line.
+inline void host_crack_job(crack_batch &batch, size_t index, crack_workspace &ws)
+{
+  const crack_job &job = batch.jobs[index];
+  double start = omp_get_wtime();
+  const char *error = 0;
+  char error_text[256];
+  size_t length = 0;
+  unsigned int key_length = 0;
+  if(!host_read_file(job.cipher_file.c_str(), ws.text, length))
+    error = host_error_text(errno, error_text, sizeof(error_text));
+  else if(length == 0)
+    error = "empty file";
+  else
+    key_length = host_key_length(&ws.text[0], length, ws.coincidences, &error);
+  if(key_length)
+  {
+    ws.shifts.resize(key_length);
+    host_key_shifts(&ws.text[0], length, key_length, ws.counts, ws.scores, &ws.shifts[0]);
+    host_vigenere_key(&ws.shifts[0], key_length, true, ws.key);
+    if(ws.plain.size() < length) ws.plain.resize(length);
+    host_vigenere_apply_omp(&ws.text[0], &ws.plain[0], length, ws.key);
+    if(!host_write_file(job.plain_file.c_str(), &ws.plain[0], length)) error = host_error_text(errno, error_text, sizeof(error_text));
+  }
+  std::string key;
+  for(unsigned int p = 0; p < key_length; p++)
+    key += (char)(ws.shifts[p] == 26 ? 'z' : ws.shifts[p] + 'a');
+  double seconds = omp_get_wtime() - start;
+
+  pthread_mutex_lock(&batch.lock);
+  fprintf(batch.out, "%zu,%s,%zu,%u,%s,%.6f,%s\n", index, job.cipher_file.c_str(), length, error ? 0 : key_length,
+          error ? "" : key.c_str(), seconds, error ? error : "ok");
+  fflush(batch.out);
+  if(error) batch.failed++; else batch.cracked++;
+  pthread_mutex_unlock(&batch.lock);
+}
+
+struct crack_worker
+{
+  crack_batch *batch;
+  crack_workspace ws;
+};
+
+inline void *host_crack_worker(void *arg)
+{
+  crack_worker &w = *(crack_worker *)arg;
+  crack_batch &batch = *w.batch;
+  // a small file is one task: its passes run on this thread alone
+  omp_set_num_threads(1);
+  for(;;)
+  {
+    pthread_mutex_lock(&batch.lock);
+    size_t k = batch.next < batch.small.size() ? batch.next++ : batch.small.size();
+    pthread_mutex_unlock(&batch.lock);
+    if(k == batch.small.size()) return 0;
+    host_crack_job(batch, batch.small[k], w.ws);
+  }
+}
+
+// Parse a manifest: one cipher text per line, optionally followed by
+// whitespace and the plain text file. Empty lines and lines starting with
+// # are skipped. Returns false with errno set if it can't be read.
+inline bool host_read_manifest(const char *name, std::vector<crack_job> &jobs)
+{
+  FILE *f = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+  if(!f) return false;
+  char line[4096];
+  while(fgets(line, sizeof(line), f))
+  {
+    char cipher_file[4096], plain_file[4096];
+    int n = sscanf(line, "%4095s %4095s", cipher_file, plain_file);
+    if(n < 1 || cipher_file[0] == '#') continue;
+    crack_job job;
+    job.cipher_file = cipher_file;
+    job.plain_file = n == 2 ? std::string(plain_file) : job.cipher_file + ".plain";
+    struct stat st;
+    job.bytes = stat(cipher_file, &st) == 0 ? st.st_size : 0;
+    jobs.push_back(job);
+  }
+  if(f != stdin) fclose(f);
+  return true;
+}
+
+// Crack everything in the manifest with nr_threads threads (0: all
+// cores), writing result lines to out. Returns the number of files that
+// failed, or -1 with errno set if the manifest can't be read.
+inline long host_crack_batch(const char *manifest, int nr_threads, FILE *out)
+{
+  crack_batch batch;
+  if(!host_read_manifest(manifest, batch.jobs)) return -1;
+  if(nr_threads <= 0) nr_threads = omp_get_max_threads();
+  std::vector<size_t> large;
+  for(size_t i = 0; i < batch.jobs.size(); i++)
+    (batch.jobs[i].bytes < crack_split_bytes ? batch.small : large).push_back(i);
+  std::stable_sort(batch.small.begin(), batch.small.end(), crack_job_larger(&batch.jobs));
+  batch.next = 0;
+  batch.out = out;
+  batch.cracked = batch.failed = 0;
+  pthread_mutex_init(&batch.lock, 0);
+
+  fprintf(out, "index,cipher_file,bytes,key_length,key,seconds,status\n");
+  fflush(out);
+  double start = omp_get_wtime();
+  std::vector<crack_worker> workers(nr_threads);
+
+  // the large files first, each with all threads, in a worker's buffers
+  omp_set_num_threads(nr_threads);
+  for(size_t i = 0; i < large.size(); i++) host_crack_job(batch, large[i], workers[0].ws);
+
+  // then the small ones on the pool
+  std::vector<pthread_t> threads(nr_threads);
+  for(int t = 0; t < nr_threads; t++)
+  {
+    workers[t].batch = &batch;
+    pthread_create(&threads[t], 0, host_crack_worker, &workers[t]);
+  }
+  for(int t = 0; t < nr_threads; t++) pthread_join(threads[t], 0);
+
+  double seconds = omp_get_wtime() - start;
+  size_t bytes = 0;
+  for(size_t i = 0; i < batch.jobs.size(); i++) bytes += batch.jobs[i].bytes;
+  fprintf(stderr, "%zu files cracked, %zu failed, %zu bytes in %.3f s (%.1f files/s, %.1f MB/s) with %d threads\n",
+          batch.cracked, batch.failed, bytes, seconds, batch.jobs.size() / seconds, bytes / seconds / 1e6,
+          nr_threads);
+  pthread_mutex_destroy(&batch.lock);
+  return (long)batch.failed;
+}
+
+#endif
@@ -0,0 +1,159 @@
+// Multithreaded CPU Vigenere encode/decode without divisions.
+//
+// The key is expanded once into a key stream that holds the (normalized)
+// shift of every key position, repeated so that any window of 32 bytes
+// starting inside the first period can be loaded in one go. A thread walks
+// its chunk with a key phase that is stepped rather than computed with
+// i % period, and the chunks are cut at multiples of the period so every
+// thread starts at phase 0.
+//
+// Letters are added as bytes in the 0..25 domain: the stream holds
+// shift - 'a' (mod 256), so c + stream[p] is (c - 'a') + shift in 0..50,
+// and min(x, x - 26) (unsigned, so x - 26 wraps to >= 230 when x < 26)
+// brings it back to 0..25 without a modulo or a branch. That is one byte
+// add, subtract and min per letter, with SSE2 or AVX2 when available.
+//
+// Only needs a C++ compiler with OpenMP, so it can be built without nvcc.
+
+#ifndef VIGENERE_CPU_H
+#define VIGENERE_CPU_H
+
+#include <vector>
+#include <stddef.h>
+#include "omp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VIGENERE_CPU_X86 1
+#include <immintrin.h>
+#endif
+
+// Widest load from the key stream (AVX2).
+const unsigned int vigenere_window = 32;
+
+struct vigenere_key
+{
+  unsigned int period;
+  std::vector<unsigned char> stream; // period + vigenere_window bytes
+};
+
+// Expand shifts[0..period) (1..26, as the cipher tools store them) into a
+// key stream, for encoding or, with decode set, for decoding.
+inline void host_vigenere_key(const unsigned int *shifts, unsigned int period, bool decode, vigenere_key &key)
+{
+  key.period = period;
+  key.stream.resize(period + vigenere_window);
+  for(unsigned int p = 0, k = 0; p < key.stream.size(); p++)
+  {
+    unsigned int s = shifts[k] % 26;
+    if(decode) s = (26 - s) % 26;
+    key.stream[p] = (unsigned char)(s - 'a');
+    if(++k == period) k = 0;
+  }
+}
+
+// One letter: (c - 'a' + shift) mod 26 + 'a', with the stream byte k.
+inline unsigned char host_vigenere_letter(unsigned char c, unsigned char k)
+{
+  unsigned char x = (unsigned char)(c + k);
+  unsigned char y = (unsigned char)(x - 26);
+  return (unsigned char)((x < y ? x : y) + 'a');
+}
+
+inline void host_vigenere_scalar(const unsigned char *input, unsigned char *output, size_t length,
+                                 unsigned int phase, const vigenere_key &key)
+{
+  const unsigned char *stream = &key.stream[0];
+  for(size_t i = 0; i < length; i++)
+  {
+    output[i] = host_vigenere_letter(input[i], stream[phase]);
+    if(++phase == key.period) phase = 0;
+  }
+}
+
+#ifdef VIGENERE_CPU_X86
+__attribute__((target("sse2")))
+inline void host_vigenere_sse2(const unsigned char *input, unsigned char *output, size_t length,
+                               unsigned int phase, const vigenere_key &key)
+{
+  const unsigned char *stream = &key.stream[0];
+  const unsigned int step = 16 % key.period;
+  const __m128i wrap = _mm_set1_epi8(26), a = _mm_set1_epi8('a');
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(input + i)),
+                             _mm_loadu_si128((const __m128i *)(stream + phase)));
+    x = _mm_min_epu8(x, _mm_sub_epi8(x, wrap));
+    _mm_storeu_si128((__m128i *)(output + i), _mm_add_epi8(x, a));
+    phase += step;
+    if(phase >= key.period) phase -= key.period;
+  }
+  host_vigenere_scalar(input + i, output + i, length - i, phase, key);
+}
+
+__attribute__((target("avx2")))
+inline void host_vigenere_avx2(const unsigned char *input, unsigned char *output, size_t length,
+                               unsigned int phase, const vigenere_key &key)
+{
+  const unsigned char *stream = &key.stream[0];
+  const unsigned int step = 32 % key.period;
+  const __m256i wrap = _mm256_set1_epi8(26), a = _mm256_set1_epi8('a');
+  size_t i = 0;
+  for(; i + 32 <= length; i += 32)
+  {
+    __m256i x = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(input + i)),
+                                _mm256_loadu_si256((const __m256i *)(stream + phase)));
+    x = _mm256_min_epu8(x, _mm256_sub_epi8(x, wrap));
+    _mm256_storeu_si256((__m256i *)(output + i), _mm256_add_epi8(x, a));
+    phase += step;
+    if(phase >= key.period) phase -= key.period;
+  }
+  host_vigenere_scalar(input + i, output + i, length - i, phase, key);
+}
+#endif
+
+// Widest kernel the CPU runs: 2 AVX2, 1 SSE2, 0 scalar.
+inline int host_vigenere_detect()
+{
+#ifdef VIGENERE_CPU_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse2") ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+// Single threaded; phase is the key position of input[0]. Safe to call
+// from several threads at once.
+inline void host_vigenere_apply(const unsigned char *input, unsigned char *output, size_t length,
+                                unsigned int phase, const vigenere_key &key)
+{
+#ifdef VIGENERE_CPU_X86
+  // initialized once, by whichever thread gets here first
+  static const int level = host_vigenere_detect();
+  if(level == 2) { host_vigenere_avx2(input, output, length, phase, key); return; }
+  if(level == 1) { host_vigenere_sse2(input, output, length, phase, key); return; }
+#endif
+  host_vigenere_scalar(input, output, length, phase, key);
+}
+
+// Encode or decode a whole sanitized text (only 'a'..'z'); input and output
+// may be the same buffer. Chunks are whole multiples of the period, so
+// every thread starts at key phase 0.
+inline void host_vigenere_apply_omp(const unsigned char *input, unsigned char *output, size_t length,
+                                    const vigenere_key &key)
+{
+  const int nr_threads = omp_get_max_threads();
+  size_t chunk = (length + nr_threads - 1) / nr_threads;
+  chunk = (chunk + key.period - 1) / key.period * key.period;
+  #pragma omp parallel for num_threads(nr_threads) schedule(static, 1)
+  for(int t = 0; t < nr_threads; t++)
+  {
+    size_t begin = (size_t)t * chunk;
+    if(begin >= length) continue;
+    size_t end = begin + chunk < length ? begin + chunk : length;
+    host_vigenere_apply(input + begin, output + begin, end - begin, 0, key);
+  }
+}
+
+#endif